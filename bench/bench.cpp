@@ -0,0 +1,420 @@
+/* Copyright (c) 2015, Chris Knight, Daniel C. Dillon
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+ 
+// Measures psig's own overhead, through signal_loop on each backend.  Results are written to stdout as CSV rows of
+// benchmark,backend,metric,value,unit so that runs can be compared between
+// releases; diagnostics go to stderr.
+//
+// usage: bench [iterations]
+
+#include <psig/psig.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+typedef std::chrono::steady_clock clock_type;
+typedef psig::signal_loop::backend backend;
+
+enum class method
+{
+    kill,
+    sigqueue,
+    tgkill
+};
+
+const backend g_backends[] = {backend::sigwait, backend::signalfd};
+const method g_methods[] = {method::kill, method::sigqueue, method::tgkill};
+
+const char *name(const backend type)
+{
+    return (type == backend::sigwait) ? "sigwait" : "signalfd";
+}
+
+const char *name(const method type)
+{
+    switch (type)
+    {
+        case method::kill:
+            return "kill";
+        case method::sigqueue:
+            return "sigqueue";
+        default:
+            return "tgkill";
+    }
+}
+
+std::int64_t now_ns()
+{
+    return std::chrono::duration_cast< std::chrono::nanoseconds >(
+               clock_type::now().time_since_epoch())
+        .count();
+}
+
+::pid_t gettid() { return static_cast< ::pid_t >(::syscall(SYS_gettid)); }
+
+void report(const std::string &benchmark,
+            const char *backend_name,
+            const char *metric,
+            const double value,
+            const char *unit)
+{
+    std::printf("%s,%s,%s,%.3f,%s\n",
+                benchmark.c_str(),
+                backend_name,
+                metric,
+                value,
+                unit);
+}
+
+// Counts syscalls entered by the calling thread through the
+// raw_syscalls:sys_enter tracepoint.  Needs tracefs and sufficient
+// perf_event_paranoid permissions; otherwise valid() is false.
+class syscall_counter
+{
+   public:
+    syscall_counter() : m_fd(-1)
+    {
+        const char *paths[] = {
+            "/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+            "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id"};
+
+        for (const char *path : paths)
+        {
+            std::ifstream in(path);
+            unsigned long long id;
+            if (!(in >> id))
+                continue;
+
+            ::perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_TRACEPOINT;
+            attr.config = id;
+            attr.disabled = 1;
+            attr.sample_period = 1;
+
+            m_fd = static_cast< int >(
+                ::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            if (m_fd >= 0)
+                break;
+        }
+    }
+    ~syscall_counter()
+    {
+        if (m_fd >= 0)
+            ::close(m_fd);
+    }
+
+    bool valid() const { return (m_fd >= 0); }
+
+    void start()
+    {
+        if (m_fd < 0)
+            return;
+
+        ::ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+        ::ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    std::uint64_t stop()
+    {
+        std::uint64_t count = 0;
+        if (m_fd < 0)
+            return count;
+
+        ::ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (::read(m_fd, &count, sizeof(count)) != sizeof(count))
+            count = 0;
+        return count;
+    }
+
+   private:
+    int m_fd;
+};
+
+void report_latencies(const std::string &benchmark,
+                      const backend type,
+                      std::vector< std::int64_t > &samples)
+{
+    std::sort(samples.begin(), samples.end());
+
+    double total = 0;
+    for (std::int64_t sample : samples) total += sample;
+
+    report(benchmark, name(type), "mean", total / samples.size(), "ns");
+    report(benchmark, name(type), "p50", samples[samples.size() / 2], "ns");
+    report(benchmark,
+           name(type),
+           "p99",
+           samples[(samples.size() * 99) / 100],
+           "ns");
+    report(benchmark, name(type), "max", samples.back(), "ns");
+}
+
+// Ping-pong: each signal is sent only after the previous one was handled, so
+// nothing coalesces and the sample is pure send-to-handler latency through
+// the loop's dispatch.
+void bench_latency(const backend type,
+                   const method how,
+                   const std::size_t iterations)
+{
+    const psig::signum_t signum = SIGUSR1;
+
+    std::vector< std::int64_t > samples(iterations);
+    std::atomic< std::int64_t > sent_at(0);
+    std::atomic< std::size_t > handled(0);
+    std::atomic< ::pid_t > tid(0);
+    std::unique_ptr< syscall_counter > counter;
+    std::uint64_t syscalls = 0;
+    bool counted = false;
+
+    // the first, untimed delivery tells the sender the loop thread for
+    // tgkill() and starts counting that thread's syscalls
+    psig::signal_loop loop;
+    loop.set_backend(type);
+    loop.set_handler(signum, [&](int) {
+        const std::int64_t received_at = now_ns();
+        const std::size_t n = handled.load();
+        if (n == 0)
+        {
+            counter.reset(new syscall_counter);
+            tid = gettid();
+            counter->start();
+        }
+        else
+        {
+            samples[n - 1] = received_at - sent_at.load();
+            if (n == iterations)
+            {
+                syscalls = counter->stop();
+                counted = counter->valid();
+            }
+        }
+        handled.store(n + 1);
+        return true;
+    });
+    loop.block_signals(psig::sigset(signum));
+    loop.exec_async();
+
+    ::kill(::getpid(), signum);
+    while (handled.load() == 0) std::this_thread::yield();
+
+    for (std::size_t i = 1; i <= iterations; ++i)
+    {
+        sent_at.store(now_ns());
+        switch (how)
+        {
+            case method::kill:
+                ::kill(::getpid(), signum);
+                break;
+            case method::sigqueue:
+            {
+                ::sigval value;
+                value.sival_int = static_cast< int >(i);
+                ::sigqueue(::getpid(), signum, value);
+                break;
+            }
+            case method::tgkill:
+                ::syscall(SYS_tgkill, ::getpid(), tid.load(), signum);
+                break;
+        }
+
+        while (handled.load() <= i) std::this_thread::yield();
+    }
+
+    loop.stop();
+
+    const std::string benchmark = std::string("latency_") + name(how);
+    report_latencies(benchmark, type, samples);
+
+    if (counted)
+    {
+        report(benchmark,
+               name(type),
+               "syscalls_per_signal",
+               static_cast< double >(syscalls) / iterations,
+               "count");
+    }
+}
+
+// The sender queues realtime signals as fast as the kernel accepts them while
+// the loop dispatches them, one at a time through a registered handler or in
+// batches through exec_batch().
+void bench_throughput(const backend type,
+                      const bool batched,
+                      const std::size_t count)
+{
+    const psig::signum_t signum = psig::rt::signum(1);
+
+    std::atomic< bool > ready(false);
+    std::size_t received = 0;
+    std::int64_t finish = 0;
+    std::unique_ptr< syscall_counter > counter;
+    std::uint64_t syscalls = 0;
+    bool counted = false;
+
+    // the first, untimed signal starts counting the loop thread's syscalls;
+    // the last one ends the loop
+    const std::function< bool(std::size_t) > take = [&](const std::size_t n) {
+        if (!ready.load())
+        {
+            counter.reset(new syscall_counter);
+            counter->start();
+            ready = true;
+            return true;
+        }
+
+        received += n;
+        if (received < count)
+            return true;
+
+        finish = now_ns();
+        syscalls = counter->stop();
+        counted = counter->valid();
+        return false;
+    };
+
+    psig::signal_loop loop;
+    loop.set_backend(type);
+    if (batched)
+    {
+        loop.set_batch_size(256);
+        loop.block_signals(psig::sigset(signum));
+        loop.exec_batch_async(
+            [&](const psig::siginfo_span &batch) { return take(batch.size()); });
+    }
+    else
+    {
+        loop.set_handler(signum, [&](int) { return take(1); });
+        loop.block_signals(psig::sigset(signum));
+        loop.exec_async();
+    }
+
+    ::sigval value;
+    value.sival_int = 0;
+    ::sigqueue(::getpid(), signum, value);
+    while (!ready.load()) std::this_thread::yield();
+
+    // the clock starts before the first send, so the first batch counts
+    const std::int64_t start = now_ns();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        while (::sigqueue(::getpid(), signum, value) != 0)
+            std::this_thread::yield();
+    }
+
+    loop.wait_for_exec_async();
+    const std::int64_t elapsed = finish - start;
+
+    const std::string benchmark =
+        batched ? "throughput_rt_batch" : "throughput_rt";
+    report(benchmark,
+           name(type),
+           "rate",
+           (elapsed > 0) ? (count * 1e9) / elapsed : 0,
+           "signals/s");
+
+    if (counted)
+    {
+        report(benchmark,
+               name(type),
+               "syscalls_per_signal",
+               static_cast< double >(syscalls) / count,
+               "count");
+    }
+}
+
+void bench_mask(const std::size_t iterations)
+{
+    const psig::sigset masks[] = {psig::sigset{SIGUSR1, SIGUSR2},
+                                  psig::sigset(true)};
+
+    std::int64_t start = now_ns();
+    for (std::size_t i = 0; i < iterations; ++i)
+        psig::this_thread::set_mask(masks[i & 1]);
+    std::int64_t elapsed = now_ns() - start;
+    report("mask_set", "none", "mean", double(elapsed) / iterations, "ns");
+
+    std::size_t sink = 0;
+    start = now_ns();
+    for (std::size_t i = 0; i < iterations; ++i)
+        sink += psig::this_thread::get_mask().size();
+    elapsed = now_ns() - start;
+    report("mask_get", "none", "mean", double(elapsed) / iterations, "ns");
+
+    if (sink == 0)
+        std::fprintf(stderr, "unexpected empty mask\n");
+}
+}  // namespace
+
+extern "C" int main(int argc, char *argv[])
+{
+    const std::size_t iterations =
+        (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 10000;
+    if (iterations == 0)
+    {
+        std::fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    // every thread started from here on inherits a fully blocked mask
+    psig::this_thread::fill_mask();
+
+    if (!syscall_counter().valid())
+        std::fprintf(stderr, "syscall counts unavailable (needs tracefs)\n");
+
+    std::printf("benchmark,backend,metric,value,unit\n");
+
+    for (backend type : g_backends)
+        for (method how : g_methods) bench_latency(type, how, iterations);
+
+    for (backend type : g_backends)
+    {
+        bench_throughput(type, false, iterations * 10);
+        bench_throughput(type, true, iterations * 10);
+    }
+
+    bench_mask(iterations * 10);
+    return 0;
+}
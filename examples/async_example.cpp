@@ -30,9 +30,7 @@
  
 #include <psig/psig.hpp>
 #include <iostream>
-#include <atomic>
-
-std::atomic< bool > g_running(true);
+#include <poll.h>
 
 bool handle_signal(int sig)
 {
@@ -52,8 +50,6 @@ bool handle_signal(int sig)
 int handle_exit()
 {
     std::cout << "Handling exit" << std::endl;
-    g_running = false;
-    
     return 0;
 }
 
@@ -62,13 +58,20 @@ extern "C" int main(int argc, char *argv[])
     psig::sigset signals{SIGINT, SIGTERM, SIGHUP};
     psig::signal_manager::block_signals(signals);
 
+    ::pollfd pfd;
+    pfd.fd = psig::signal_manager::notify_fd();
+    pfd.events = POLLIN;
+
     psig::signal_manager::exec_async(handle_signal, handle_exit);
     
     // do initialization here
     
-    while (g_running)
+    while (!psig::signal_manager::finished())
     {
-        // application's event loop
+        // application's event loop, woken whenever a signal was handled
+        ::poll(&pfd, 1, -1);
+        ::eventfd_t count;
+        ::eventfd_read(pfd.fd, &count);
     }
     
     psig::signal_manager::wait_for_exec_async();
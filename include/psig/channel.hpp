@@ -0,0 +1,216 @@
+/* Copyright (c) 2015, Chris Knight, Daniel C. Dillon
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <psig/psig.hpp>
+#include <cstring>
+#include <type_traits>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace psig
+{
+namespace rt
+{
+namespace impl
+{
+struct credentials
+{
+    ::pid_t pid;
+    ::uid_t uid;
+};
+
+inline credentials &self_storage()
+{
+    static credentials creds = {::getpid(), ::getuid()};
+    return creds;
+}
+
+inline void refresh_self()
+{
+    self_storage().pid = ::getpid();
+    self_storage().uid = ::getuid();
+}
+
+// Sender credentials are cached so that a send is a single syscall; the
+// cache is refreshed in the child after fork().
+inline const credentials &self()
+{
+    static const int registered =
+        ::pthread_atfork(nullptr, nullptr, &refresh_self);
+    (void)registered;
+    return self_storage();
+}
+
+inline ::siginfo_t make_siginfo(const signum_t signum, const ::sigval &value)
+{
+    ::siginfo_t info;
+    std::memset(&info, 0, sizeof(info));
+    info.si_signo = signum;
+    info.si_code = SI_QUEUE;
+    info.si_pid = self().pid;
+    info.si_uid = self().uid;
+    info.si_value = value;
+    return info;
+}
+}  // namespace impl
+
+template < typename T >
+struct message
+{
+    T payload;
+    ::pid_t pid;
+    ::uid_t uid;
+};
+
+// A realtime signal carrying a payload of type T in its sigval.  The receiving
+// side keeps the signal blocked and reads it through a signalfd, so the
+// signal must be blocked in every thread of the receiving process: construct
+// the channel before starting other threads (or before
+// signal_manager::block_signals()).  The signal stays blocked in the
+// constructing thread after the channel is destroyed, so that a message still
+// in flight cannot take the signal's default action and end the process.
+template < typename T = int >
+class channel
+{
+    static_assert(std::is_trivially_copyable< T >::value,
+                  "channel payloads must be trivially copyable");
+    static_assert(sizeof(T) <= sizeof(::sigval),
+                  "channel payloads must fit in a sigval");
+
+   public:
+    typedef T value_type;
+    typedef rt::message< T > message_type;
+
+    static const std::size_t max_batch = 64;
+
+    channel() : m_signum(rt::reserve()), m_owned(m_signum > 0) { open(); }
+    // Fails to open if signum is already reserved by another owner.
+    explicit channel(const signum_t signum)
+        : m_signum(signum), m_owned(rt::reserve(signum))
+    {
+        open();
+    }
+    ~channel()
+    {
+        m_fd.close();
+        if (m_owned)
+            rt::release(m_signum);
+    }
+
+    channel(const channel &) = delete;
+    channel &operator=(const channel &) = delete;
+
+    bool is_open() const noexcept { return m_fd.is_open(); }
+    signum_t signum() const noexcept { return m_signum; }
+
+    typedef int native_handle_type;
+    native_handle_type native_handle() const noexcept
+    {
+        return m_fd.native_handle();
+    }
+
+    bool send(const ::pid_t pid, const T &value) const noexcept
+    {
+        ::siginfo_t info = impl::make_siginfo(m_signum, encode(value));
+        return (::syscall(SYS_rt_sigqueueinfo, pid, m_signum, &info) == 0);
+    }
+
+    bool send(const ::pid_t tgid, const ::pid_t tid, const T &value) const
+        noexcept
+    {
+        ::siginfo_t info = impl::make_siginfo(m_signum, encode(value));
+        return (::syscall(SYS_rt_tgsigqueueinfo, tgid, tid, m_signum, &info) ==
+                0);
+    }
+
+    bool receive(message_type &msg) noexcept
+    {
+        ::siginfo_t info;
+        if (m_fd.read(&info) != m_signum)
+            return false;
+
+        msg = decode(info);
+        return true;
+    }
+
+    // Receives up to max_batch queued messages with a single read.
+    ::ssize_t receive(message_type *msgs, std::size_t count) noexcept
+    {
+        ::siginfo_t infos[max_batch];
+        if (count > max_batch)
+            count = max_batch;
+
+        const ::ssize_t received = m_fd.read(infos, count);
+        for (::ssize_t i = 0; i < received; ++i)
+            msgs[i] = decode(infos[i]);
+        return received;
+    }
+
+    static ::sigval encode(const T &value) noexcept
+    {
+        ::sigval sv;
+        std::memset(&sv, 0, sizeof(sv));
+        std::memcpy(&sv, &value, sizeof(value));
+        return sv;
+    }
+
+    static message_type decode(const ::siginfo_t &info) noexcept
+    {
+        message_type msg;
+        std::memcpy(&msg.payload, &info.si_value, sizeof(msg.payload));
+        msg.pid = info.si_pid;
+        msg.uid = info.si_uid;
+        return msg;
+    }
+
+   private:
+    void open() noexcept
+    {
+        if (!m_owned)
+            return;
+
+        this_thread::add_mask(m_signum);
+        m_fd.open(sigset(m_signum));
+    }
+
+   private:
+    signum_t m_signum;
+    bool m_owned;
+    signal_fd m_fd;
+};
+
+template < typename T >
+const std::size_t channel< T >::max_batch;
+}  // namespace rt
+}  // namespace psig
@@ -0,0 +1,196 @@
+/* Copyright (c) 2015, Chris Knight, Daniel C. Dillon
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <psig/psig.hpp>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+namespace psig
+{
+struct child_exit
+{
+    ::pid_t pid;
+    int status;
+    ::rusage usage;
+
+    bool exited() const { return WIFEXITED(status); }
+    int exit_status() const { return WEXITSTATUS(status); }
+    bool signaled() const { return WIFSIGNALED(status); }
+    int term_signal() const { return WTERMSIG(status); }
+};
+
+// Reaps every exited child on SIGCHLD and hands each status, with the
+// child's resource usage, to whoever registered for that pid.  SIGCHLD
+// coalesces, so each reap() drains all waiting children in one batch.
+// Children that exit before anyone watches them are kept until watch() or
+// prune_unclaimed().  The monitor reaps all children of the process, so
+// nothing else should wait for them.
+class child_monitor
+{
+   public:
+    typedef std::function< void(const child_exit &) > callback_type;
+
+    child_monitor() = default;
+
+    child_monitor(const child_monitor &) = delete;
+    child_monitor &operator=(const child_monitor &) = delete;
+
+    // Runs callback on the reaping thread once pid has exited, or right
+    // away if it already has.  Returns false if pid is already watched.
+    bool watch(const ::pid_t pid, const callback_type &callback)
+    {
+        std::unique_lock< std::mutex > lock(m_mutex);
+
+        const auto unclaimed = m_unclaimed.find(pid);
+        if (unclaimed != m_unclaimed.end())
+        {
+            const child_exit status = unclaimed->second;
+            m_unclaimed.erase(unclaimed);
+            lock.unlock();
+
+            callback(status);
+            return true;
+        }
+
+        return m_watchers.emplace(pid, callback).second;
+    }
+
+    std::future< child_exit > watch(const ::pid_t pid)
+    {
+        std::shared_ptr< std::promise< child_exit > > promise =
+            std::make_shared< std::promise< child_exit > >();
+        std::future< child_exit > future = promise->get_future();
+
+        if (!watch(pid,
+                   [promise](const child_exit &status) {
+                       promise->set_value(status);
+                   }))
+            return std::future< child_exit >();
+
+        return future;
+    }
+
+    bool unwatch(const ::pid_t pid)
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        return m_watchers.erase(pid) > 0;
+    }
+
+    std::size_t watched() const
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        return m_watchers.size();
+    }
+
+    std::size_t unclaimed() const
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        return m_unclaimed.size();
+    }
+
+    std::size_t prune_unclaimed()
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        const std::size_t count = m_unclaimed.size();
+        m_unclaimed.clear();
+        return count;
+    }
+
+    // Collects every child that has exited and runs the callbacks
+    // registered for them.  Returns the number of children reaped.
+    std::size_t reap()
+    {
+        std::vector< child_exit > batch;
+        for (;;)
+        {
+            child_exit status;
+            std::memset(&status, 0, sizeof(status));
+
+            status.pid = ::wait4(-1, &status.status, WNOHANG, &status.usage);
+            if (status.pid <= 0)
+                break;
+            batch.push_back(status);
+        }
+
+        if (batch.empty())
+            return 0;
+
+        std::vector< std::pair< callback_type, child_exit > > ready;
+        ready.reserve(batch.size());
+        {
+            std::lock_guard< std::mutex > lock(m_mutex);
+            for (const child_exit &status : batch)
+            {
+                const auto watcher = m_watchers.find(status.pid);
+                if (watcher == m_watchers.end())
+                {
+                    m_unclaimed[status.pid] = status;
+                    continue;
+                }
+
+                ready.emplace_back(std::move(watcher->second), status);
+                m_watchers.erase(watcher);
+            }
+        }
+
+        for (const auto &entry : ready)
+            entry.first(entry.second);
+
+        return batch.size();
+    }
+
+    // Reaps on every SIGCHLD handled by loop.
+    bool attach(signal_loop &loop)
+    {
+        return loop.set_handler(SIGCHLD, [this](int) {
+            reap();
+            return true;
+        });
+    }
+
+    bool attach() { return attach(signal_manager::loop()); }
+
+   private:
+    mutable std::mutex m_mutex;
+    std::unordered_map< ::pid_t, callback_type > m_watchers;
+    std::unordered_map< ::pid_t, child_exit > m_unclaimed;
+};
+}  // namespace psig
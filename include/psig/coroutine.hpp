@@ -0,0 +1,335 @@
+/* Copyright (c) 2015, Chris Knight, Daniel C. Dillon
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <psig/psig.hpp>
+
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+
+#include <cerrno>
+#include <coroutine>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <poll.h>
+
+namespace psig
+{
+// Coroutine signal waits.  The waited signals must be blocked in every thread
+// (see signal_manager::block_signals()); each wait reads a non-blocking
+// signalfd and only suspends when nothing is pending.
+//
+// An Executor provides
+//
+//     void on_readable(int fd, Callback &&callback);
+//
+// which invokes callback() once, on the executor, after fd becomes readable.
+// The coroutine is resumed from inside that callback.
+
+namespace impl
+{
+template < typename Executor >
+class signal_read_awaiter
+{
+   public:
+    signal_read_awaiter(signal_fd &fd,
+                        Executor &executor,
+                        ::siginfo_t *infos,
+                        const std::size_t count) noexcept
+        : m_fd(fd)
+        , m_executor(executor)
+        , m_infos(infos)
+        , m_count(count)
+        , m_result(-1)
+    {
+    }
+
+    bool await_ready() noexcept { return try_read(); }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        m_handle = handle;
+        arm();
+    }
+
+    ::ssize_t await_resume() const noexcept { return m_result; }
+
+   private:
+    // Returns false only when the descriptor has nothing to read yet.
+    bool try_read() noexcept
+    {
+        m_result = m_fd.read(m_infos, m_count);
+        return (m_result > 0 || (errno != EAGAIN && errno != EINTR));
+    }
+
+    void arm()
+    {
+        m_executor.on_readable(m_fd.native_handle(), [this]() {
+            if (try_read())
+                m_handle.resume();
+            else
+                arm();
+        });
+    }
+
+   private:
+    signal_fd &m_fd;
+    Executor &m_executor;
+    ::siginfo_t *m_infos;
+    std::size_t m_count;
+    ::ssize_t m_result;
+    std::coroutine_handle<> m_handle;
+};
+
+// One non-blocking signalfd per signal set and thread, kept open so that
+// repeated async_wait() calls do not open and close a descriptor each time.
+inline signal_fd &cached_signal_fd(const sigset &signals)
+{
+    static thread_local std::unordered_map< sigset::mask_type,
+                                            std::unique_ptr< signal_fd > >
+        fds;
+
+    std::unique_ptr< signal_fd > &fd = fds[signals.mask()];
+    if (!fd)
+        fd.reset(new signal_fd);
+    if (!fd->is_open())
+        fd->open(signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    return *fd;
+}
+}  // namespace impl
+
+// co_await async_wait(signals, executor) yields the next siginfo_t; its
+// si_signo is 0 if the signalfd could not be opened or read.  Waits on the
+// same set from one thread share a signalfd that stays open until the
+// thread exits.
+template < typename Executor >
+class signal_awaitable
+{
+   public:
+    signal_awaitable(const sigset &signals, Executor &executor) noexcept
+        : m_fd(impl::cached_signal_fd(signals))
+        , m_awaiter(m_fd, executor, &m_info, 1)
+    {
+        std::memset(&m_info, 0, sizeof(m_info));
+    }
+
+    signal_awaitable(const signal_awaitable &) = delete;
+    signal_awaitable &operator=(const signal_awaitable &) = delete;
+
+    bool await_ready() noexcept
+    {
+        return (!m_fd.is_open() || m_awaiter.await_ready());
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        m_awaiter.await_suspend(handle);
+    }
+
+    ::siginfo_t await_resume() const noexcept
+    {
+        if (m_awaiter.await_resume() <= 0)
+        {
+            ::siginfo_t info;
+            std::memset(&info, 0, sizeof(info));
+            return info;
+        }
+        return m_info;
+    }
+
+   private:
+    signal_fd &m_fd;
+    ::siginfo_t m_info;
+    impl::signal_read_awaiter< Executor > m_awaiter;
+};
+
+template < typename Executor >
+inline signal_awaitable< Executor > async_wait(const sigset &signals,
+                                               Executor &executor)
+{
+    return signal_awaitable< Executor >(signals, executor);
+}
+
+// An asynchronous stream of siginfo_t over one persistent signalfd.  Each
+// co_await next() returns a buffered record when one is available and
+// otherwise drains every pending signal with a single read.
+template < typename Executor >
+class signal_stream
+{
+   public:
+    class next_awaitable
+    {
+       public:
+        explicit next_awaitable(signal_stream &stream) noexcept
+            : m_stream(stream)
+            , m_awaiter(stream.m_fd,
+                        stream.m_executor,
+                        stream.m_infos.data(),
+                        stream.m_infos.size())
+        {
+        }
+
+        bool await_ready() noexcept
+        {
+            return (m_stream.buffered() || !m_stream.m_fd.is_open() ||
+                    m_awaiter.await_ready());
+        }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            m_awaiter.await_suspend(handle);
+        }
+
+        ::siginfo_t await_resume() noexcept
+        {
+            if (!m_stream.buffered())
+                m_stream.refill(m_awaiter.await_resume());
+            return m_stream.pop();
+        }
+
+       private:
+        signal_stream &m_stream;
+        impl::signal_read_awaiter< Executor > m_awaiter;
+    };
+
+    signal_stream(const sigset &signals,
+                  Executor &executor,
+                  const std::size_t batch = 64)
+        : m_fd(signals, SFD_NONBLOCK | SFD_CLOEXEC)
+        , m_executor(executor)
+        , m_infos(batch > 0 ? batch : 1)
+        , m_next(0)
+        , m_size(0)
+    {
+    }
+
+    signal_stream(const signal_stream &) = delete;
+    signal_stream &operator=(const signal_stream &) = delete;
+
+    bool is_open() const noexcept { return m_fd.is_open(); }
+
+    next_awaitable next() noexcept { return next_awaitable(*this); }
+
+   private:
+    bool buffered() const noexcept { return (m_next < m_size); }
+
+    void refill(const ::ssize_t count) noexcept
+    {
+        m_next = 0;
+        m_size = (count > 0) ? static_cast< std::size_t >(count) : 0;
+    }
+
+    ::siginfo_t pop() noexcept
+    {
+        if (!buffered())
+        {
+            ::siginfo_t info;
+            std::memset(&info, 0, sizeof(info));
+            return info;
+        }
+        return m_infos[m_next++];
+    }
+
+   private:
+    signal_fd m_fd;
+    Executor &m_executor;
+    std::vector< ::siginfo_t > m_infos;
+    std::size_t m_next;
+    std::size_t m_size;
+};
+
+// A minimal single-threaded executor satisfying the Executor requirements,
+// for applications that do not already have a reactor.
+class poll_executor
+{
+   public:
+    template < typename Callback >
+    void on_readable(const int fd, Callback &&callback)
+    {
+        m_waiters.push_back(
+            waiter{fd, std::function< void() >(std::forward< Callback >(callback))});
+    }
+
+    bool empty() const noexcept { return m_waiters.empty(); }
+
+    // Waits up to timeout_msec for any watched descriptor and runs the
+    // callbacks of those that are ready.  Returns the number run, or -1.
+    int run_once(const int timeout_msec = -1)
+    {
+        std::vector< ::pollfd > pfds(m_waiters.size());
+        for (std::size_t i = 0; i < m_waiters.size(); ++i)
+        {
+            pfds[i].fd = m_waiters[i].fd;
+            pfds[i].events = POLLIN;
+            pfds[i].revents = 0;
+        }
+
+        const int ready = ::poll(pfds.data(), pfds.size(), timeout_msec);
+        if (ready <= 0)
+            return ready;
+
+        std::vector< std::function< void() > > callbacks;
+        std::vector< waiter > waiting;
+        for (std::size_t i = 0; i < m_waiters.size(); ++i)
+        {
+            if (pfds[i].revents)
+                callbacks.push_back(std::move(m_waiters[i].callback));
+            else
+                waiting.push_back(std::move(m_waiters[i]));
+        }
+        m_waiters.swap(waiting);
+
+        for (std::function< void() > &callback : callbacks) callback();
+        return static_cast< int >(callbacks.size());
+    }
+
+    void run()
+    {
+        while (!empty() && run_once() >= 0)
+        {
+        }
+    }
+
+   private:
+    struct waiter
+    {
+        int fd;
+        std::function< void() > callback;
+    };
+
+    std::vector< waiter > m_waiters;
+};
+}  // namespace psig
+
+#endif
@@ -0,0 +1,453 @@
+/* Copyright (c) 2015, Chris Knight, Daniel C. Dillon
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <psig/psig.hpp>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <mutex>
+#include <setjmp.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+extern "C" {
+inline void psig_fault_handler(int signum, ::siginfo_t *info, void *context);
+}
+
+namespace psig
+{
+// Synchronous SIGBUS/SIGSEGV handling for registered address ranges, e.g. a
+// file mapping that may be truncated underneath the reader.  The signal
+// handler finds the faulting range without locks and applies its policy;
+// faults outside every range go to the previously installed action.
+namespace fault
+{
+enum class policy
+{
+    recover,    // jump back to the innermost protect() with an error code
+    zero_fill,  // map a zero page over the faulting page and retry
+    hook        // call a user function; it decides whether to retry
+};
+
+// Runs inside the signal handler, so it must be async-signal-safe.  Return
+// true when the faulting access can be retried.
+typedef bool (*hook_type)(const ::siginfo_t &info, void *user);
+
+typedef int region_id;
+
+static const region_id invalid_region = -1;
+
+namespace impl
+{
+struct recovery_point
+{
+    ::sigjmp_buf env;
+    recovery_point *prev;
+    int error;
+    void *address;
+};
+
+inline recovery_point *&recovery()
+{
+    static thread_local recovery_point *current = nullptr;
+    return current;
+}
+
+// One registry entry.  Writers serialise on the registry mutex and bump
+// the sequence around every change; the signal handler retries its copy
+// if the sequence moved or was odd.
+struct region
+{
+    std::atomic< unsigned > sequence;
+    std::atomic< std::uintptr_t > begin;
+    std::atomic< std::uintptr_t > end;
+    std::atomic< int > type;
+    std::atomic< int > value;
+    std::atomic< hook_type > hook;
+    std::atomic< void * > user;
+};
+
+struct region_copy
+{
+    std::uintptr_t begin;
+    std::uintptr_t end;
+    policy type;
+    int value;
+    hook_type hook;
+    void *user;
+};
+
+class registry
+{
+   public:
+    static const std::size_t capacity = 64;
+
+    static inline registry &instance()
+    {
+        static registry r;
+        return r;
+    }
+
+    inline region_id add(const void *address,
+                         const std::size_t length,
+                         const policy type,
+                         const int value,
+                         const hook_type hook,
+                         void *user)
+    {
+        if (address == nullptr || length == 0)
+            return invalid_region;
+
+        std::lock_guard< std::mutex > lock(m_mutex);
+
+        if (!install())
+            return invalid_region;
+
+        for (std::size_t i = 0; i < capacity; ++i)
+        {
+            region &r = m_regions[i];
+            if (r.end.load(std::memory_order_relaxed) != 0)
+                continue;
+
+            const std::uintptr_t begin =
+                reinterpret_cast< std::uintptr_t >(address);
+            write(r, begin, begin + length, type, value, hook, user);
+            return static_cast< region_id >(i);
+        }
+
+        return invalid_region;
+    }
+
+    inline bool remove(const region_id id)
+    {
+        if (id < 0 || static_cast< std::size_t >(id) >= capacity)
+            return false;
+
+        std::lock_guard< std::mutex > lock(m_mutex);
+
+        region &r = m_regions[id];
+        if (r.end.load(std::memory_order_relaxed) == 0)
+            return false;
+
+        write(r, 0, 0, policy::recover, 0, nullptr, nullptr);
+        return true;
+    }
+
+    inline std::size_t size() const
+    {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < capacity; ++i)
+            if (m_regions[i].end.load(std::memory_order_relaxed) != 0)
+                ++count;
+        return count;
+    }
+
+    inline bool find(const std::uintptr_t address, region_copy &copy) const
+    {
+        for (std::size_t i = 0; i < capacity; ++i)
+        {
+            if (read(m_regions[i], copy) && address >= copy.begin &&
+                address < copy.end)
+                return true;
+        }
+        return false;
+    }
+
+    inline void handle(const int signum, ::siginfo_t *info, void *context)
+    {
+        // only the kernel reports faults; for kill() and friends si_addr
+        // aliases the sender's pid and uid
+        if (info->si_code > 0)
+        {
+            const std::uintptr_t address =
+                reinterpret_cast< std::uintptr_t >(info->si_addr);
+
+            region_copy r;
+            if (find(address, r) && apply(r, info))
+                return;
+        }
+
+        forward(signum, info, context);
+    }
+
+   private:
+    inline registry() : m_installed(false)
+    {
+        for (std::size_t i = 0; i < capacity; ++i)
+        {
+            m_regions[i].sequence.store(0, std::memory_order_relaxed);
+            m_regions[i].begin.store(0, std::memory_order_relaxed);
+            m_regions[i].end.store(0, std::memory_order_relaxed);
+            m_regions[i].type.store(0, std::memory_order_relaxed);
+            m_regions[i].value.store(0, std::memory_order_relaxed);
+            m_regions[i].hook.store(nullptr, std::memory_order_relaxed);
+            m_regions[i].user.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    registry(const registry &) = delete;
+    registry &operator=(const registry &) = delete;
+
+    inline bool install()
+    {
+        if (m_installed)
+            return true;
+
+        // SA_NODEFER keeps the signal unblocked while the handler runs, so
+        // a recovery jump leaves the thread mask as it was
+        struct ::sigaction &action = m_action;
+        std::memset(&action, 0, sizeof(action));
+        ::sigemptyset(&action.sa_mask);
+        action.sa_sigaction = &::psig_fault_handler;
+        action.sa_flags = SA_SIGINFO | SA_NODEFER | SA_ONSTACK;
+
+        if (::sigaction(SIGBUS, &action, &m_previous[0]) != 0)
+            return false;
+        if (::sigaction(SIGSEGV, &action, &m_previous[1]) != 0)
+        {
+            ::sigaction(SIGBUS, &m_previous[0], nullptr);
+            return false;
+        }
+
+        m_installed = true;
+        return true;
+    }
+
+    static inline void write(region &r,
+                             const std::uintptr_t begin,
+                             const std::uintptr_t end,
+                             const policy type,
+                             const int value,
+                             const hook_type hook,
+                             void *user)
+    {
+        const unsigned sequence = r.sequence.load(std::memory_order_relaxed);
+        r.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        r.begin.store(begin, std::memory_order_relaxed);
+        r.end.store(end, std::memory_order_relaxed);
+        r.type.store(static_cast< int >(type), std::memory_order_relaxed);
+        r.value.store(value, std::memory_order_relaxed);
+        r.hook.store(hook, std::memory_order_relaxed);
+        r.user.store(user, std::memory_order_relaxed);
+
+        r.sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    static inline bool read(const region &r, region_copy &copy)
+    {
+        for (int attempt = 0; attempt < 16; ++attempt)
+        {
+            const unsigned before = r.sequence.load(std::memory_order_acquire);
+            if (before & 1)
+                continue;
+
+            copy.begin = r.begin.load(std::memory_order_relaxed);
+            copy.end = r.end.load(std::memory_order_relaxed);
+            copy.type =
+                static_cast< policy >(r.type.load(std::memory_order_relaxed));
+            copy.value = r.value.load(std::memory_order_relaxed);
+            copy.hook = r.hook.load(std::memory_order_relaxed);
+            copy.user = r.user.load(std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (r.sequence.load(std::memory_order_relaxed) == before)
+                return copy.end != 0;
+        }
+        return false;
+    }
+
+    static inline bool apply(const region_copy &r, ::siginfo_t *info)
+    {
+        switch (r.type)
+        {
+            case policy::recover:
+            {
+                recovery_point *point = recovery();
+                if (point == nullptr)
+                    return false;
+
+                point->error = r.value;
+                point->address = info->si_addr;
+                ::siglongjmp(point->env, 1);
+            }
+
+            case policy::zero_fill:
+            {
+                const std::uintptr_t page =
+                    static_cast< std::uintptr_t >(::sysconf(_SC_PAGESIZE));
+                void *base = reinterpret_cast< void * >(
+                    reinterpret_cast< std::uintptr_t >(info->si_addr) &
+                    ~(page - 1));
+                return (::mmap(base,
+                               page,
+                               r.value,
+                               MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED,
+                               -1,
+                               0) != MAP_FAILED);
+            }
+
+            case policy::hook:
+                return (r.hook != nullptr && r.hook(*info, r.user));
+        }
+        return false;
+    }
+
+    inline void forward(const int signum, ::siginfo_t *info, void *context)
+    {
+        const struct ::sigaction &previous =
+            m_previous[signum == SIGBUS ? 0 : 1];
+
+        if (previous.sa_flags & SA_SIGINFO)
+        {
+            if (previous.sa_sigaction != nullptr)
+            {
+                previous.sa_sigaction(signum, info, context);
+                return;
+            }
+        }
+        else if (previous.sa_handler != SIG_DFL &&
+                 previous.sa_handler != SIG_IGN)
+        {
+            previous.sa_handler(signum);
+            return;
+        }
+
+        struct ::sigaction fallback;
+        std::memset(&fallback, 0, sizeof(fallback));
+        ::sigemptyset(&fallback.sa_mask);
+        fallback.sa_handler = SIG_DFL;
+
+        if (info->si_code > 0)
+        {
+            // a fault cannot be ignored; let the retried access take the
+            // default action
+            ::sigaction(signum, &fallback, nullptr);
+            return;
+        }
+
+        // a sent signal takes the previous disposition now, and the
+        // registry stays installed if the process survives it
+        if (previous.sa_handler == SIG_IGN)
+            return;
+
+        ::sigaction(signum, &fallback, nullptr);
+        ::raise(signum);
+        ::sigaction(signum, &m_action, nullptr);
+    }
+
+   private:
+    std::mutex m_mutex;
+    bool m_installed;
+    struct ::sigaction m_action;
+    struct ::sigaction m_previous[2];
+    region m_regions[capacity];
+};
+}  // namespace impl
+
+// Faults in the range jump back to the innermost protect() on the faulting
+// thread, which returns error.  Faults outside protect() are not handled.
+inline region_id add_recover(const void *address,
+                             const std::size_t length,
+                             const int error = EFAULT)
+{
+    return impl::registry::instance().add(
+        address, length, policy::recover, error, nullptr, nullptr);
+}
+
+// Faults in the range are satisfied by mapping a private zero page with the
+// given protection, so reads past the end of a truncated file see zeros.
+inline region_id add_zero_fill(const void *address,
+                               const std::size_t length,
+                               const int prot = PROT_READ)
+{
+    return impl::registry::instance().add(
+        address, length, policy::zero_fill, prot, nullptr, nullptr);
+}
+
+inline region_id add_hook(const void *address,
+                          const std::size_t length,
+                          const hook_type hook,
+                          void *user = nullptr)
+{
+    if (hook == nullptr)
+        return invalid_region;
+
+    return impl::registry::instance().add(
+        address, length, policy::hook, 0, hook, user);
+}
+
+inline bool remove(const region_id id)
+{
+    return impl::registry::instance().remove(id);
+}
+
+// Runs fn and returns 0, or the error of the recover region whose fault
+// interrupted it.  The jump skips destructors of objects created inside
+// fn, so fn should only copy out of the mapping.
+template < typename Function >
+inline int protect(Function fn, void **address = nullptr)
+{
+    impl::recovery_point point;
+    point.prev = impl::recovery();
+    point.error = 0;
+    point.address = nullptr;
+
+    if (::sigsetjmp(point.env, 0) == 0)
+    {
+        // the signal handler must see the recovery point before fn runs
+        impl::recovery() = &point;
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        fn();
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        impl::recovery() = point.prev;
+        return 0;
+    }
+
+    impl::recovery() = point.prev;
+    if (address != nullptr)
+        *address = point.address;
+    return point.error;
+}
+}  // namespace fault
+}  // namespace psig
+
+extern "C" {
+inline void psig_fault_handler(int signum, ::siginfo_t *info, void *context)
+{
+    const int saved = errno;
+    psig::fault::impl::registry::instance().handle(signum, info, context);
+    errno = saved;
+}
+}
@@ -0,0 +1,217 @@
+/* Copyright (c) 2015, Chris Knight, Daniel C. Dillon
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <psig/psig.hpp>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace psig
+{
+// Kicks registered threads out of blocking syscalls with a thread-directed
+// realtime signal.  The signal's handler does nothing and is installed
+// without SA_RESTART, so the interrupted call fails with EINTR; the thread
+// then reads why it was woken from its pending-reason word.
+class thread_interrupter
+{
+   public:
+    typedef std::uint64_t reason_type;
+    typedef std::size_t thread_handle;
+
+    static const thread_handle invalid_handle = ~thread_handle(0);
+
+    // A signum of 0 reserves a free realtime signal for the interrupter's
+    // lifetime; a given signum remains the caller's.
+    explicit thread_interrupter(const std::size_t capacity = 64,
+                                const signum_t signum = 0)
+        : m_signum(signum > 0 ? signum : rt::reserve())
+        , m_owned(signum <= 0 && m_signum > 0)
+        , m_slots(allocate(capacity))
+        , m_capacity(m_slots ? capacity : 0)
+    {
+        for (std::size_t i = 0; i < m_capacity; ++i)
+        {
+            m_slots.get()[i].tid.store(0, std::memory_order_relaxed);
+            m_slots.get()[i].reasons.store(0, std::memory_order_relaxed);
+        }
+
+        if (m_signum > 0)
+        {
+            ::sigaction(m_signum, nullptr, &m_previous);
+            this_process::set_action(sigset(m_signum));
+        }
+    }
+
+    // Threads must be unregistered first.
+    ~thread_interrupter()
+    {
+        if (m_signum > 0)
+            ::sigaction(m_signum, &m_previous, nullptr);
+        if (m_owned)
+            rt::release(m_signum);
+    }
+
+    thread_interrupter(const thread_interrupter &) = delete;
+    thread_interrupter &operator=(const thread_interrupter &) = delete;
+
+    signum_t signum() const noexcept { return m_signum; }
+
+    // Registers the calling thread and unblocks the signal in it.  Returns
+    // invalid_handle when every slot is taken.
+    thread_handle register_thread() noexcept
+    {
+        if (m_signum <= 0)
+            return invalid_handle;
+
+        const ::pid_t tid = static_cast< ::pid_t >(::syscall(SYS_gettid));
+        for (std::size_t i = 0; i < m_capacity; ++i)
+        {
+            slot &s = m_slots.get()[i];
+            ::pid_t expected = 0;
+            if (s.tid.compare_exchange_strong(expected, tid))
+            {
+                s.reasons.store(0, std::memory_order_relaxed);
+                s.blocked = this_thread::sub_mask(m_signum).has(m_signum);
+                return i;
+            }
+        }
+        return invalid_handle;
+    }
+
+    // Call from the registered thread: the signal is blocked again if it was
+    // blocked before register_thread().
+    void unregister_thread(const thread_handle handle) noexcept
+    {
+        if (handle >= m_capacity)
+            return;
+
+        slot &s = m_slots.get()[handle];
+        const ::pid_t tid = static_cast< ::pid_t >(::syscall(SYS_gettid));
+        if (s.tid.load(std::memory_order_relaxed) == tid && s.blocked)
+            this_thread::add_mask(m_signum);
+        s.tid.store(0, std::memory_order_release);
+    }
+
+    // Adds reasons to the thread's pending word and signals it.
+    bool interrupt(const thread_handle handle, const reason_type reasons) noexcept
+    {
+        if (handle >= m_capacity)
+            return false;
+
+        slot &s = m_slots.get()[handle];
+        const ::pid_t tid = s.tid.load(std::memory_order_acquire);
+        if (tid == 0)
+            return false;
+
+        s.reasons.fetch_or(reasons, std::memory_order_release);
+        return (::syscall(SYS_tgkill, ::getpid(), tid, m_signum) == 0);
+    }
+
+    std::size_t interrupt(const std::vector< thread_handle > &handles,
+                          const reason_type reasons) noexcept
+    {
+        std::size_t interrupted = 0;
+        for (thread_handle handle : handles)
+            if (interrupt(handle, reasons))
+                ++interrupted;
+        return interrupted;
+    }
+
+    std::size_t interrupt_all(const reason_type reasons) noexcept
+    {
+        std::size_t interrupted = 0;
+        for (std::size_t i = 0; i < m_capacity; ++i)
+            if (interrupt(i, reasons))
+                ++interrupted;
+        return interrupted;
+    }
+
+    reason_type pending(const thread_handle handle) const noexcept
+    {
+        if (handle >= m_capacity)
+            return 0;
+        return m_slots.get()[handle].reasons.load(std::memory_order_acquire);
+    }
+
+    // Returns and clears the thread's pending reasons.
+    reason_type take(const thread_handle handle) noexcept
+    {
+        if (handle >= m_capacity)
+            return 0;
+        return m_slots.get()[handle].reasons.exchange(0,
+                                                      std::memory_order_acquire);
+    }
+
+   private:
+    // one cache line per slot, so that waking one thread does not disturb
+    // its neighbours
+    struct alignas(64) slot
+    {
+        std::atomic< reason_type > reasons;
+        std::atomic< ::pid_t > tid;
+        bool blocked;
+    };
+
+    struct slot_deleter
+    {
+        void operator()(slot *slots) const noexcept { std::free(slots); }
+    };
+
+    typedef std::unique_ptr< slot, slot_deleter > slot_array;
+
+    // new[] need not honour alignas(64) before C++17
+    static slot *allocate(const std::size_t capacity) noexcept
+    {
+        void *memory = nullptr;
+        if (capacity == 0 ||
+            ::posix_memalign(&memory, alignof(slot), capacity * sizeof(slot)) != 0)
+            return nullptr;
+
+        slot *slots = static_cast< slot * >(memory);
+        for (std::size_t i = 0; i < capacity; ++i)
+            new (&slots[i]) slot();
+        return slots;
+    }
+
+   private:
+    signum_t m_signum;
+    bool m_owned;
+    slot_array m_slots;
+    std::size_t m_capacity;
+    struct ::sigaction m_previous;
+};
+}  // namespace psig
@@ -0,0 +1,442 @@
+/* Copyright (c) 2015, Chris Knight, Daniel C. Dillon
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <psig/psig.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace psig
+{
+// An asynchronous file logger.  Each writing thread appends records to its
+// own single-producer ring; a background thread gathers the rings with
+// writev() and is the only one to touch the file.  Reopening (for log
+// rotation) and flushing are requests to that thread, so signal handlers
+// can trigger them without ever blocking a writer.  A writer whose ring is
+// full drops the record rather than wait.
+//
+// Records from one thread keep their order; records from different threads
+// are interleaved per drain.
+class async_logger
+{
+    struct slot;
+
+   public:
+    // Claims a ring for the calling thread.  Keep one per thread.
+    class writer
+    {
+       public:
+        explicit writer(async_logger &logger)
+            : m_logger(&logger)
+            , m_slot(logger.claim())
+        {
+        }
+
+        ~writer()
+        {
+            if (m_slot != nullptr)
+                m_slot->owned.store(false, std::memory_order_release);
+        }
+
+        writer(const writer &) = delete;
+        writer &operator=(const writer &) = delete;
+
+        bool is_open() const noexcept { return m_slot != nullptr; }
+
+        // Appends one record; include the newline if one is wanted.
+        bool write(const char *data, const std::size_t size) noexcept
+        {
+            if (m_slot == nullptr)
+                return false;
+            return m_logger->append(*m_slot, data, size);
+        }
+
+        bool write(const std::string &line) noexcept
+        {
+            return write(line.data(), line.size());
+        }
+
+       private:
+        async_logger *m_logger;
+        slot *m_slot;
+    };
+
+    explicit async_logger(const std::string &path,
+                          const std::size_t ring_size = 1 << 16,
+                          const std::size_t max_writers = 64,
+                          const std::chrono::milliseconds interval =
+                              std::chrono::milliseconds(10))
+        : m_path(path)
+        , m_fd(-1)
+        , m_ring_size((std::max< std::size_t >(ring_size, 64) + 3) & ~std::size_t(3))
+        , m_slots(new slot[max_writers > 0 ? max_writers : 1])
+        , m_capacity(max_writers > 0 ? max_writers : 1)
+        , m_interval(interval)
+        , m_running(true)
+        , m_reopen(false)
+        , m_flush_requests(0)
+        , m_flushed(0)
+        , m_written(0)
+    {
+        for (std::size_t i = 0; i < m_capacity; ++i)
+        {
+            m_slots[i].owned.store(false, std::memory_order_relaxed);
+            m_slots[i].head.store(0, std::memory_order_relaxed);
+            m_slots[i].tail.store(0, std::memory_order_relaxed);
+            m_slots[i].dropped.store(0, std::memory_order_relaxed);
+        }
+
+        m_fd = open_file();
+        m_wakeup.open();
+        m_thread = std::thread(&async_logger::run, this);
+    }
+
+    ~async_logger()
+    {
+        m_running = false;
+        m_wakeup.notify();
+        m_thread.join();
+
+        if (m_fd >= 0)
+            ::close(m_fd);
+    }
+
+    async_logger(const async_logger &) = delete;
+    async_logger &operator=(const async_logger &) = delete;
+
+    bool is_open() const noexcept { return m_fd >= 0; }
+
+    // Asks the drain thread to reopen the file by path, e.g. after it was
+    // renamed by log rotation.  Returns at once.
+    void request_reopen() noexcept
+    {
+        m_reopen = true;
+        m_wakeup.notify();
+    }
+
+    // Asks the drain thread to write out and sync everything buffered.
+    // Returns at once.
+    void request_flush() noexcept
+    {
+        m_flush_requests.fetch_add(1);
+        m_wakeup.notify();
+    }
+
+    // Returns once every record appended before the call is in the file.
+    void flush()
+    {
+        const std::uint64_t target = m_flush_requests.fetch_add(1) + 1;
+        m_wakeup.notify();
+
+        std::unique_lock< std::mutex > lock(m_mutex);
+        m_flushed_cv.wait(lock, [&]() { return m_flushed >= target; });
+    }
+
+    // Reopens on reopen and flushes on flush, both handled by loop.
+    bool attach(signal_loop &loop,
+                const signum_t reopen = SIGHUP,
+                const signum_t flush = SIGUSR1)
+    {
+        return loop.set_handler(reopen,
+                                [this](int) {
+                                    request_reopen();
+                                    return true;
+                                }) &&
+               loop.set_handler(flush, [this](int) {
+                   request_flush();
+                   return true;
+               });
+    }
+
+    bool attach(const signum_t reopen = SIGHUP, const signum_t flush = SIGUSR1)
+    {
+        return attach(signal_manager::loop(), reopen, flush);
+    }
+
+    // Bytes written to the file so far.
+    std::uint64_t written() const noexcept { return m_written; }
+
+    // Records dropped because a writer's ring was full.
+    std::uint64_t dropped() const noexcept
+    {
+        std::uint64_t count = 0;
+        for (std::size_t i = 0; i < m_capacity; ++i)
+            count += m_slots[i].dropped.load(std::memory_order_relaxed);
+        return count;
+    }
+
+   private:
+    static const std::uint32_t wrap_marker = ~std::uint32_t(0);
+
+    // head and tail sit on separate cache lines: one is written by the
+    // owning thread, the other by the drain thread
+    struct slot
+    {
+        std::atomic< bool > owned;
+        std::unique_ptr< char[] > ring;
+        std::atomic< std::uint64_t > dropped;
+        char padding0[64];
+        std::atomic< std::uint64_t > head;
+        char padding1[64 - sizeof(std::atomic< std::uint64_t >)];
+        std::atomic< std::uint64_t > tail;
+        char padding2[64 - sizeof(std::atomic< std::uint64_t >)];
+    };
+
+    static std::size_t record_size(const std::size_t size)
+    {
+        return sizeof(std::uint32_t) + ((size + 3) & ~std::size_t(3));
+    }
+
+    int open_file() const
+    {
+        return ::open(m_path.c_str(),
+                      O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                      0644);
+    }
+
+    slot *claim()
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+
+        const std::size_t start = impl::thread_index();
+        for (std::size_t n = 0; n < m_capacity; ++n)
+        {
+            slot &s = m_slots[(start + n) % m_capacity];
+            if (s.owned.load(std::memory_order_relaxed))
+                continue;
+
+            // a released ring is reused only once it has been drained
+            if (s.head.load(std::memory_order_relaxed) !=
+                s.tail.load(std::memory_order_acquire))
+                continue;
+
+            if (!s.ring)
+                s.ring.reset(new char[m_ring_size]);
+            s.owned.store(true, std::memory_order_relaxed);
+            return &s;
+        }
+        return nullptr;
+    }
+
+    bool append(slot &s, const char *data, const std::size_t size) noexcept
+    {
+        const std::size_t need = record_size(size);
+        const std::uint64_t head = s.head.load(std::memory_order_relaxed);
+        const std::uint64_t tail = s.tail.load(std::memory_order_acquire);
+
+        std::size_t position = head % m_ring_size;
+        const std::size_t contiguous = m_ring_size - position;
+        const std::size_t skip = (contiguous < need) ? contiguous : 0;
+
+        if (need > m_ring_size || head + skip + need - tail > m_ring_size)
+        {
+            s.dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        if (skip > 0)
+        {
+            const std::uint32_t marker = wrap_marker;
+            std::memcpy(&s.ring[position], &marker, sizeof(marker));
+            position = 0;
+        }
+
+        const std::uint32_t length = static_cast< std::uint32_t >(size);
+        std::memcpy(&s.ring[position], &length, sizeof(length));
+        std::memcpy(&s.ring[position + sizeof(length)], data, size);
+
+        s.head.store(head + skip + need, std::memory_order_release);
+        return true;
+    }
+
+    void run()
+    {
+        this_thread::fill_mask();
+
+        std::vector< ::iovec > iov;
+        std::vector< std::uint64_t > tails(m_capacity);
+
+        for (;;)
+        {
+            const bool running = m_running;
+
+            ::pollfd pfd;
+            pfd.fd = m_wakeup.native_handle();
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            if (running)
+                ::poll(&pfd, 1, static_cast< int >(m_interval.count()));
+            m_wakeup.consume();
+
+            if (m_reopen.exchange(false))
+                reopen();
+
+            const std::uint64_t requested = m_flush_requests.load();
+            drain(iov, tails);
+
+            if (requested > m_flushed)
+            {
+                if (m_fd >= 0)
+                    ::fdatasync(m_fd);
+
+                std::lock_guard< std::mutex > lock(m_mutex);
+                m_flushed = requested;
+                m_flushed_cv.notify_all();
+            }
+
+            if (!running)
+                break;
+        }
+    }
+
+    void reopen()
+    {
+        const int fd = open_file();
+        if (fd < 0)
+            return;
+
+        if (m_fd >= 0)
+            ::close(m_fd);
+        m_fd = fd;
+    }
+
+    // Gathers every buffered record into as few writev() calls as possible
+    // and only then hands the space back to the writers.
+    void drain(std::vector< ::iovec > &iov, std::vector< std::uint64_t > &tails)
+    {
+        bool more = true;
+        while (more)
+        {
+            more = false;
+            iov.clear();
+
+            for (std::size_t i = 0; i < m_capacity; ++i)
+            {
+                slot &s = m_slots[i];
+                std::uint64_t tail = s.tail.load(std::memory_order_relaxed);
+                tails[i] = tail;
+
+                // the ring is allocated before head first moves
+                const std::uint64_t head = s.head.load(std::memory_order_acquire);
+                while (tail != head)
+                {
+                    if (iov.size() == IOV_MAX)
+                    {
+                        more = true;
+                        break;
+                    }
+
+                    const std::size_t position = tail % m_ring_size;
+                    std::uint32_t length;
+                    std::memcpy(&length, &s.ring[position], sizeof(length));
+                    if (length == wrap_marker)
+                    {
+                        tail += m_ring_size - position;
+                        continue;
+                    }
+
+                    ::iovec v;
+                    v.iov_base = &s.ring[position + sizeof(length)];
+                    v.iov_len = length;
+                    if (length > 0)
+                        iov.push_back(v);
+                    tail += record_size(length);
+                }
+                tails[i] = tail;
+            }
+
+            write_all(iov);
+
+            for (std::size_t i = 0; i < m_capacity; ++i)
+                m_slots[i].tail.store(tails[i], std::memory_order_release);
+        }
+    }
+
+    void write_all(std::vector< ::iovec > &iov)
+    {
+        std::size_t first = 0;
+        while (first < iov.size() && m_fd >= 0)
+        {
+            const int count =
+                static_cast< int >(std::min< std::size_t >(iov.size() - first, IOV_MAX));
+            const ::ssize_t bytes = ::writev(m_fd, &iov[first], count);
+            if (bytes < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return;
+            }
+            m_written += bytes;
+
+            // skip what was written, including a partially written entry
+            std::size_t left = static_cast< std::size_t >(bytes);
+            while (first < iov.size() && left >= iov[first].iov_len)
+                left -= iov[first++].iov_len;
+            if (left > 0)
+            {
+                iov[first].iov_base = static_cast< char * >(iov[first].iov_base) + left;
+                iov[first].iov_len -= left;
+            }
+        }
+    }
+
+   private:
+    std::string m_path;
+    int m_fd;
+    std::size_t m_ring_size;
+    std::unique_ptr< slot[] > m_slots;
+    std::size_t m_capacity;
+    std::chrono::milliseconds m_interval;
+    event_fd m_wakeup;
+    std::atomic< bool > m_running;
+    std::atomic< bool > m_reopen;
+    std::atomic< std::uint64_t > m_flush_requests;
+    std::uint64_t m_flushed;
+    std::atomic< std::uint64_t > m_written;
+    std::mutex m_mutex;
+    std::condition_variable m_flushed_cv;
+    std::thread m_thread;
+};
+}  // namespace psig
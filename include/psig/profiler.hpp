@@ -0,0 +1,460 @@
+/* Copyright (c) 2015, Chris Knight, Daniel C. Dillon
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <psig/psig.hpp>
+#include <psig/timer.hpp>
+#include <psig/stack.hpp>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <execinfo.h>
+#include <time.h>
+
+extern "C" {
+inline void psig_profile_handler(int signum, ::siginfo_t *info, void *context);
+}
+
+namespace psig
+{
+// A sampling CPU profiler.  Every registered thread gets a timer on its own
+// CPU clock that signals that thread; the handler records the interrupted
+// stack into the thread's preallocated ring without locks or allocation.
+// drain() moves the samples into an aggregate that write_folded() prints in
+// the folded-stack format understood by flame graph tools.
+class profiler
+{
+   public:
+    typedef std::size_t thread_handle;
+
+    static const thread_handle invalid_handle = ~thread_handle(0);
+    static const std::size_t max_depth = 32;
+
+    // A signum of 0 reserves a free realtime signal for the profiler's
+    // lifetime; a given signum remains the caller's.
+    explicit profiler(const unsigned frequency = 99,
+                      const std::size_t capacity = 64,
+                      const std::size_t ring_size = 1024,
+                      const signum_t signum = 0)
+        : m_signum(signum > 0 ? signum : rt::reserve())
+        , m_owned(signum <= 0 && m_signum > 0)
+        , m_frequency(frequency > 0 ? frequency : 1)
+        , m_slots(new slot[capacity])
+        , m_capacity(capacity)
+        , m_ring_size(ring_size > 0 ? ring_size : 1)
+        , m_running(false)
+        , m_samples(0)
+        , m_drain_timer(0)
+        , m_loop(nullptr)
+        , m_toggle(0)
+    {
+        for (std::size_t i = 0; i < m_capacity; ++i)
+        {
+            m_slots[i].tid.store(0, std::memory_order_relaxed);
+            m_slots[i].head.store(0, std::memory_order_relaxed);
+            m_slots[i].tail.store(0, std::memory_order_relaxed);
+            m_slots[i].dropped.store(0, std::memory_order_relaxed);
+        }
+
+        if (!impl::signal_owner< profiler >::set(m_signum, this))
+            return;
+
+        // the first backtrace() loads the unwinder, which must not happen
+        // inside the signal handler
+        void *warmup[1];
+        ::backtrace(warmup, 1);
+
+        struct ::sigaction action;
+        std::memset(&action, 0, sizeof(action));
+        ::sigfillset(&action.sa_mask);
+        action.sa_sigaction = &::psig_profile_handler;
+        action.sa_flags = SA_SIGINFO | SA_RESTART;
+        ::sigaction(m_signum, &action, &m_previous);
+    }
+
+    ~profiler()
+    {
+        stop();
+
+        // a signal still queued for a cleared handler is consumed by the
+        // loop, which keeps running
+        if (m_loop != nullptr)
+        {
+            if (m_timers)
+                m_loop->clear_handler(m_timers->signum());
+            if (m_toggle > 0)
+                m_loop->clear_handler(m_toggle);
+        }
+
+        for (std::size_t i = 0; i < m_capacity; ++i)
+            if (m_slots[i].tid.load(std::memory_order_relaxed) != 0)
+                ::timer_delete(m_slots[i].timer);
+
+        if (m_signum > 0 && m_signum < impl::signal_owner< profiler >::max_signum)
+        {
+            // ignoring the signal discards samples still queued; then wait
+            // for handlers already running before the slots go away
+            struct ::sigaction ignore;
+            std::memset(&ignore, 0, sizeof(ignore));
+            ignore.sa_handler = SIG_IGN;
+            ::sigaction(m_signum, &ignore, nullptr);
+            impl::signal_owner< profiler >::reset(m_signum);
+            ::sigaction(m_signum, &m_previous, nullptr);
+        }
+
+        if (m_owned)
+            rt::release(m_signum);
+    }
+
+    profiler(const profiler &) = delete;
+    profiler &operator=(const profiler &) = delete;
+
+    signum_t signum() const noexcept { return m_signum; }
+
+    bool running() const noexcept { return m_running; }
+
+    // Registers the calling thread: creates its CPU-clock timer and unblocks
+    // the profiling signal in it.  Call unregister_thread() before the
+    // thread exits.
+    thread_handle register_thread()
+    {
+        if (m_signum <= 0)
+            return invalid_handle;
+
+        std::lock_guard< std::mutex > lock(m_mutex);
+
+        const ::pid_t tid = static_cast< ::pid_t >(::syscall(SYS_gettid));
+        for (std::size_t i = 0; i < m_capacity; ++i)
+        {
+            slot &s = m_slots[i];
+            if (s.tid.load(std::memory_order_relaxed) != 0)
+                continue;
+
+            if (!s.ring)
+                s.ring.reset(new sample[m_ring_size]);
+
+            ::sigevent event;
+            std::memset(&event, 0, sizeof(event));
+            event.sigev_notify = SIGEV_THREAD_ID;
+            event.sigev_signo = m_signum;
+            event.sigev_notify_thread_id = tid;
+            event.sigev_value.sival_int = static_cast< int >(i);
+
+            if (::timer_create(CLOCK_THREAD_CPUTIME_ID, &event, &s.timer) != 0)
+                return invalid_handle;
+
+            s.tid.store(tid, std::memory_order_relaxed);
+            this_thread::sub_mask(m_signum);
+
+            if (m_running)
+                arm(s, interval());
+            return i;
+        }
+
+        return invalid_handle;
+    }
+
+    void unregister_thread(const thread_handle handle)
+    {
+        if (handle >= m_capacity)
+            return;
+
+        std::lock_guard< std::mutex > lock(m_mutex);
+
+        slot &s = m_slots[handle];
+        if (s.tid.load(std::memory_order_relaxed) == 0)
+            return;
+
+        ::timer_delete(s.timer);
+        s.tid.store(0, std::memory_order_relaxed);
+    }
+
+    // Arms the timers of every registered thread.  After attach(), the
+    // rings are also drained periodically until stop().
+    void start()
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+
+        m_running = true;
+        for (std::size_t i = 0; i < m_capacity; ++i)
+            if (m_slots[i].tid.load(std::memory_order_relaxed) != 0)
+                arm(m_slots[i], interval());
+
+        if (m_timers && m_drain_timer == 0)
+            m_drain_timer =
+                m_timers->schedule_periodic(drain_interval(), [this]() { drain(); });
+    }
+
+    void stop()
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+
+        m_running = false;
+        for (std::size_t i = 0; i < m_capacity; ++i)
+            if (m_slots[i].tid.load(std::memory_order_relaxed) != 0)
+                arm(m_slots[i], 0);
+
+        if (m_timers && m_drain_timer != 0)
+        {
+            m_timers->cancel(m_drain_timer);
+            m_drain_timer = 0;
+        }
+    }
+
+    // Moves every recorded sample into the aggregate.  Returns the number
+    // of samples moved.
+    std::size_t drain()
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < m_capacity; ++i)
+        {
+            slot &s = m_slots[i];
+            if (!s.ring)
+                continue;
+
+            const std::size_t head = s.head.load(std::memory_order_acquire);
+            std::size_t tail = s.tail.load(std::memory_order_relaxed);
+            for (; tail != head; ++tail, ++count)
+            {
+                const sample &x = s.ring[tail % m_ring_size];
+                std::vector< void * > stack(x.frames, x.frames + x.depth);
+                ++m_folded[stack];
+            }
+            s.tail.store(tail, std::memory_order_release);
+        }
+
+        m_samples += count;
+        return count;
+    }
+
+    // Samples drained so far.
+    std::uint64_t samples() const
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        return m_samples;
+    }
+
+    // Samples lost because a thread's ring was full.
+    std::uint64_t dropped() const
+    {
+        std::uint64_t count = 0;
+        for (std::size_t i = 0; i < m_capacity; ++i)
+            count += m_slots[i].dropped.load(std::memory_order_relaxed);
+        return count;
+    }
+
+    void clear()
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        m_folded.clear();
+        m_samples = 0;
+    }
+
+    // One line per distinct stack, outermost frame first:
+    // "main;run;parse 42".
+    void write_folded(std::ostream &out) const
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+
+        // stacks that differ only in addresses within the same functions
+        // fold into one line
+        std::map< void *, std::string > names;
+        std::map< std::string, std::uint64_t > folded;
+        for (const auto &entry : m_folded)
+        {
+            const std::vector< void * > &stack = entry.first;
+
+            std::string line;
+            for (std::size_t i = stack.size(); i-- > 0;)
+            {
+                std::string &name = names[stack[i]];
+                if (name.empty())
+                    name = impl::symbol(stack[i], i == 0);
+
+                line += name;
+                if (i > 0)
+                    line += ';';
+            }
+            folded[line] += entry.second;
+        }
+
+        for (const auto &entry : folded)
+            out << entry.first << ' ' << entry.second << '\n';
+        out.flush();
+    }
+
+    // Toggles profiling through loop: the first toggle signal starts
+    // sampling, the next stops it and writes the folded profile to path.
+    // While sampling, a timer drains the rings on the loop thread well
+    // before they fill.  Attach to one loop only; the destructor clears the
+    // handlers there.
+    bool attach(signal_loop &loop,
+                const std::string &path,
+                const signum_t toggle = SIGUSR2)
+    {
+        if (m_loop != nullptr && m_loop != &loop)
+            return false;
+
+        if (!m_timers)
+        {
+            m_timers.reset(new timer_service(std::chrono::milliseconds(10)));
+            if (!m_timers->is_open() || !m_timers->attach(loop))
+            {
+                m_timers.reset();
+                return false;
+            }
+        }
+
+        m_loop = &loop;
+        m_toggle = toggle;
+        return loop.set_handler(toggle, [this, path](int) {
+            if (!running())
+            {
+                clear();
+                start();
+                return true;
+            }
+
+            stop();
+            drain();
+            std::ofstream out(path.c_str(), std::ios::trunc);
+            write_folded(out);
+            return true;
+        });
+    }
+
+    bool attach(const std::string &path, const signum_t toggle = SIGUSR2)
+    {
+        return attach(signal_manager::loop(), path, toggle);
+    }
+
+    // Called from the signal handler on the sampled thread.
+    static void record(const int signum, ::siginfo_t *info, void *context) noexcept
+    {
+        if (info->si_code != SI_TIMER)
+            return;
+
+        const impl::signal_owner< profiler >::scope owner(signum);
+        profiler *self = owner.get();
+        const std::size_t index =
+            static_cast< std::size_t >(info->si_value.sival_int);
+        if (self == nullptr || index >= self->m_capacity)
+            return;
+
+        slot &s = self->m_slots[index];
+        const std::size_t size = self->m_ring_size;
+        const std::size_t head = s.head.load(std::memory_order_relaxed);
+        if (head - s.tail.load(std::memory_order_acquire) >= size)
+        {
+            s.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        sample &x = s.ring[head % size];
+        const int depth =
+            ::backtrace(x.frames, static_cast< int >(max_depth));
+        x.depth = static_cast< std::uint32_t >(
+            impl::trim_stack(x.frames, depth > 0 ? depth : 0, context));
+        s.head.store(head + 1, std::memory_order_release);
+    }
+
+   private:
+    struct sample
+    {
+        std::uint32_t depth;
+        void *frames[max_depth];
+    };
+
+    struct slot
+    {
+        std::atomic< ::pid_t > tid;
+        ::timer_t timer;
+        std::unique_ptr< sample[] > ring;
+        std::atomic< std::size_t > head;
+        std::atomic< std::size_t > tail;
+        std::atomic< std::uint64_t > dropped;
+    };
+
+    long interval() const { return 1000000000L / m_frequency; }
+
+    // Half the time a ring takes to fill.
+    std::chrono::nanoseconds drain_interval() const
+    {
+        const std::chrono::nanoseconds half(interval() *
+                                            static_cast< long >(m_ring_size) / 2);
+        return (half > std::chrono::milliseconds(10)) ? half
+                                                      : std::chrono::milliseconds(10);
+    }
+
+    static void arm(slot &s, const long interval_nsec)
+    {
+        ::itimerspec spec;
+        spec.it_value.tv_sec = interval_nsec / 1000000000L;
+        spec.it_value.tv_nsec = interval_nsec % 1000000000L;
+        spec.it_interval = spec.it_value;
+        ::timer_settime(s.timer, 0, &spec, nullptr);
+    }
+
+   private:
+    signum_t m_signum;
+    bool m_owned;
+    struct ::sigaction m_previous;
+    unsigned m_frequency;
+    std::unique_ptr< slot[] > m_slots;
+    std::size_t m_capacity;
+    std::size_t m_ring_size;
+    std::atomic< bool > m_running;
+    mutable std::mutex m_mutex;
+    std::map< std::vector< void * >, std::uint64_t > m_folded;
+    std::uint64_t m_samples;
+    std::unique_ptr< timer_service > m_timers;
+    timer_service::timer_id m_drain_timer;
+    signal_loop *m_loop;
+    signum_t m_toggle;
+};
+}  // namespace psig
+
+extern "C" {
+inline void psig_profile_handler(int signum, ::siginfo_t *info, void *context)
+{
+    const int saved = errno;
+    psig::profiler::record(signum, info, context);
+    errno = saved;
+}
+}
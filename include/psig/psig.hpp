@@ -30,16 +30,32 @@
  
 #pragma once
 
-#include <cstring>
 #include <thread>
 #include <chrono>
-#include <unordered_set>
-#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
 #include <signal.h>
+#include <pthread.h>
+#include <sched.h>
+#include <climits>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
 #include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <vector>
 #include <functional>
+#include <mutex>
+#include <string>
+#include <array>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 
 extern "C" {
 inline void psig_signal_handler(int signum) {}
@@ -47,59 +63,106 @@ inline void psig_signal_handler(int signum) {}
 
 namespace psig
 {
-class sigset;
-namespace this_thread
-{
-namespace impl
-{
-sigset get_mask();
-}  // namespace impl
-}  // namespace this_thread
-
 typedef int signum_t;
 typedef int sigcnt_t;
 
 class sigset
 {
    public:
-    sigset() noexcept { clear(); }
-    sigset(const sigset &s) noexcept : m_signals(s.m_signals)
+    typedef std::uint64_t mask_type;
+
+    static_assert(_NSIG - 1 <= 64, "sigset requires at most 64 signals");
+
+    class const_iterator
     {
-        copy_handle(s);
-    }
-    sigset(std::initializer_list< signum_t > il) noexcept { init_handle(il); }
-    ~sigset() noexcept = default;
+       public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef signum_t value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const signum_t *pointer;
+        typedef signum_t reference;
+
+        constexpr const_iterator() noexcept : m_bits(0) {}
+        constexpr explicit const_iterator(const mask_type bits) noexcept
+            : m_bits(bits)
+        {
+        }
+
+        signum_t operator*() const noexcept
+        {
+            return __builtin_ctzll(m_bits) + 1;
+        }
+
+        const_iterator &operator++() noexcept
+        {
+            m_bits &= m_bits - 1;
+            return *this;
+        }
+        const_iterator operator++(int) noexcept
+        {
+            const_iterator it(*this);
+            ++(*this);
+            return it;
+        }
+
+        constexpr bool operator==(const const_iterator &that) const noexcept
+        {
+            return (m_bits == that.m_bits);
+        }
+        constexpr bool operator!=(const const_iterator &that) const noexcept
+        {
+            return (m_bits != that.m_bits);
+        }
 
-    explicit sigset(const signum_t signum) noexcept { init_handle({signum}); }
-    explicit sigset(const bool) noexcept { fill(); }
+       private:
+        mask_type m_bits;
+    };
+    typedef const_iterator iterator;
 
-    sigset &operator=(const sigset &that) noexcept
+    constexpr sigset() noexcept : m_bits(0) {}
+    constexpr sigset(std::initializer_list< signum_t > il) noexcept
+        : m_bits(mask_of(il.begin(), il.end()))
     {
-        copy_handle(that);
-        m_signals = that.m_signals;
-        return *this;
     }
 
-    typedef ::sigset_t *native_handle_type;
-    native_handle_type native_handle() const
+    constexpr explicit sigset(const signum_t signum) noexcept
+        : m_bits(bit(signum))
     {
-        return const_cast< native_handle_type >(&m_handle);
+    }
+    constexpr explicit sigset(const bool full) noexcept
+        : m_bits(full ? all() : 0)
+    {
+    }
+    explicit sigset(const ::sigset_t &handle) noexcept : m_bits(0)
+    {
+        for (signum_t signum = 1; signum < _NSIG; ++signum)
+            if (::sigismember(&handle, signum) == 1)
+                m_bits |= bit(signum);
     }
 
-    typedef std::unordered_set< signum_t > signals_type;
-    const signals_type &signals() const { return m_signals; }
-
-    void insert(const signum_t signum) noexcept
+    static constexpr sigset from_mask(const mask_type bits) noexcept
     {
-        ::sigaddset(&m_handle, signum);
-        m_signals.insert(signum);
+        return sigset(bits, 0);
     }
-    void erase(const signum_t signum) noexcept
+
+    typedef ::sigset_t native_handle_type;
+    native_handle_type native_handle() const noexcept
     {
-        ::sigdelset(&m_handle, signum);
-        m_signals.erase(signum);
+        ::sigset_t handle;
+        ::sigemptyset(&handle);
+        for (signum_t signum : *this)
+            ::sigaddset(&handle, signum);
+        return handle;
     }
 
+    constexpr mask_type mask() const noexcept { return m_bits; }
+
+    const_iterator begin() const noexcept { return const_iterator(m_bits); }
+    const_iterator end() const noexcept { return const_iterator(); }
+
+    void insert(const signum_t signum) noexcept { m_bits |= bit(signum); }
+    void erase(const signum_t signum) noexcept { m_bits &= ~bit(signum); }
+
     sigset &operator+=(const signum_t signum) noexcept
     {
         insert(signum);
@@ -111,58 +174,98 @@ class sigset
         return *this;
     }
 
-    bool operator==(const sigset &that) const
+    sigset &operator|=(const sigset &that) noexcept
+    {
+        m_bits |= that.m_bits;
+        return *this;
+    }
+    sigset &operator&=(const sigset &that) noexcept
+    {
+        m_bits &= that.m_bits;
+        return *this;
+    }
+    constexpr sigset operator|(const sigset &that) const noexcept
+    {
+        return sigset(m_bits | that.m_bits, 0);
+    }
+    constexpr sigset operator&(const sigset &that) const noexcept
     {
-        return (m_signals == that.m_signals);
+        return sigset(m_bits & that.m_bits, 0);
     }
-    bool operator!=(const sigset &that) const
+    constexpr sigset operator~() const noexcept
     {
-        return (m_signals != that.m_signals);
+        return sigset(~m_bits & all(), 0);
     }
 
-    bool has(const signum_t signum)
+    constexpr bool operator==(const sigset &that) const noexcept
     {
-        return (m_signals.find(signum) != m_signals.end());
+        return (m_bits == that.m_bits);
+    }
+    constexpr bool operator!=(const sigset &that) const noexcept
+    {
+        return (m_bits != that.m_bits);
     }
-    bool empty() const { return (m_signals.size() == 0); }
 
-    void fill() { ::sigfillset(&m_handle); }
-    void clear()
+    constexpr bool has(const signum_t signum) const noexcept
     {
-        ::sigemptyset(&m_handle);
-        m_signals.clear();
+        return ((m_bits & bit(signum)) != 0);
     }
+    constexpr bool empty() const noexcept { return (m_bits == 0); }
+    std::size_t size() const noexcept { return __builtin_popcountll(m_bits); }
+
+    void fill() noexcept { m_bits = all(); }
+    void clear() noexcept { m_bits = 0; }
 
    private:
-    friend sigset this_thread::impl::get_mask();  // for init_handle()
+    constexpr sigset(const mask_type bits, int) noexcept : m_bits(bits) {}
 
-    void copy_handle(const sigset &that)
+    static constexpr mask_type all() noexcept
     {
-        std::memcpy(&m_handle, &that.m_handle, sizeof(m_handle));
+        return (_NSIG - 1 == 64) ? ~mask_type(0)
+                                 : ((mask_type(1) << (_NSIG - 1)) - 1);
     }
-    void init_handle(std::initializer_list< signum_t > signums)
+    static constexpr mask_type bit(const signum_t signum) noexcept
     {
-        clear();
-        for (signum_t signum : signums)
-        {
-            insert(signum);
-        }
+        return (signum > 0 && signum < _NSIG) ? (mask_type(1) << (signum - 1))
+                                              : 0;
+    }
+    static constexpr mask_type mask_of(const signum_t *first,
+                                       const signum_t *last) noexcept
+    {
+        return (first == last) ? 0 : (bit(*first) | mask_of(first + 1, last));
     }
-    void init_handle()
+
+   private:
+    mask_type m_bits;
+};
+
+class siginfo_span
+{
+   public:
+    typedef const ::siginfo_t *const_iterator;
+    typedef const_iterator iterator;
+
+    siginfo_span() noexcept : m_data(nullptr), m_size(0) {}
+    siginfo_span(const ::siginfo_t *data, const std::size_t size) noexcept
+        : m_data(data), m_size(size)
     {
-        for (signum_t signum : std::vector< signum_t >{
-                 SIGTERM, SIGINT, SIGHUP, SIGUSR1, SIGUSR2, SIGPWR, SIGALRM})
-            if (::sigismember(&m_handle, signum))
-                m_signals.insert(signum);
+    }
+
+    const ::siginfo_t *data() const noexcept { return m_data; }
+    std::size_t size() const noexcept { return m_size; }
+    bool empty() const noexcept { return (m_size == 0); }
 
-        for (signum_t signum = 0; signum <= SIGRTMAX - SIGRTMIN; ++signum)
-            if (::sigismember(&m_handle, SIGRTMIN + signum))
-                m_signals.insert(SIGRTMIN + signum);
+    const_iterator begin() const noexcept { return m_data; }
+    const_iterator end() const noexcept { return m_data + m_size; }
+
+    const ::siginfo_t &operator[](const std::size_t i) const noexcept
+    {
+        return m_data[i];
     }
 
    private:
-    ::sigset_t m_handle;
-    signals_type m_signals;
+    const ::siginfo_t *m_data;
+    std::size_t m_size;
 };
 
 namespace rt
@@ -172,25 +275,119 @@ inline signum_t sigmax() { return SIGRTMAX; }
 inline signum_t sigcount() { return sigmax() - sigmin(); }
 inline signum_t signum(const sigcnt_t rtsigcnt) { return sigmin() + rtsigcnt; }
 inline sigcnt_t sigcnt(const signum_t rtsignum) { return rtsignum - sigmin(); }
+
+namespace impl
+{
+inline std::atomic< sigset::mask_type > &reservations()
+{
+    static std::atomic< sigset::mask_type > reserved(0);
+    return reserved;
+}
+}  // namespace impl
+
+// Claims a specific realtime signal for exclusive use within the process.
+inline bool reserve(const signum_t signum) noexcept
+{
+    if (signum < sigmin() || signum > sigmax())
+        return false;
+
+    const sigset::mask_type bit = sigset(signum).mask();
+    return ((impl::reservations().fetch_or(bit) & bit) == 0);
+}
+
+// Claims the highest free realtime signal, or returns -1 if none is left.
+inline signum_t reserve() noexcept
+{
+    for (signum_t signum = sigmax(); signum >= sigmin(); --signum)
+        if (reserve(signum))
+            return signum;
+    return -1;
+}
+
+inline void release(const signum_t signum) noexcept
+{
+    if (signum < sigmin() || signum > sigmax())
+        return;
+
+    impl::reservations().fetch_and(~sigset(signum).mask());
+}
+
+inline bool reserved(const signum_t signum) noexcept
+{
+    return ((impl::reservations().load() & sigset(signum).mask()) != 0);
+}
 }  // namespace rt
 
 namespace this_thread
 {
 namespace impl
 {
+// The calling thread's mask as last set or read through psig, so that
+// get_mask() and no-op mask changes need no syscall.
+struct mask_cache
+{
+    bool valid;
+    sigset::mask_type mask;
+};
+
+inline mask_cache &cache() noexcept
+{
+    static thread_local mask_cache cached = {false, 0};
+    return cached;
+}
+
+// Signals that can actually appear in a thread's mask: neither SIGKILL and
+// SIGSTOP nor the signals reserved by the C library.
+inline sigset::mask_type blockable() noexcept
+{
+    static const sigset::mask_type mask =
+        (sigset(sigset(true).native_handle()) & ~sigset{SIGKILL, SIGSTOP})
+            .mask();
+    return mask;
+}
+
 inline sigset set_mask(const int how, const sigset &newset)
 {
-    sigset oldset;
-    ::pthread_sigmask(how, newset.native_handle(), oldset.native_handle());
+    mask_cache &cached = cache();
+    if (cached.valid)
+    {
+        sigset::mask_type mask = newset.mask();
+        if (how == SIG_BLOCK)
+            mask = cached.mask | mask;
+        else if (how == SIG_UNBLOCK)
+            mask = cached.mask & ~mask;
+
+        if ((mask & blockable()) == cached.mask)
+            return sigset::from_mask(cached.mask);
+    }
+
+    const ::sigset_t handle = newset.native_handle();
+    ::sigset_t oldhandle;
+    ::pthread_sigmask(how, &handle, &oldhandle);
+
+    const sigset oldset(oldhandle);
+    sigset::mask_type mask = newset.mask();
+    if (how == SIG_BLOCK)
+        mask = oldset.mask() | mask;
+    else if (how == SIG_UNBLOCK)
+        mask = oldset.mask() & ~mask;
+
+    cached.mask = mask & blockable();
+    cached.valid = true;
     return oldset;
 }
 
 inline sigset get_mask()
 {
-    sigset oldset;
-    ::pthread_sigmask(SIG_UNBLOCK, nullptr, oldset.native_handle());
-    oldset.init_handle();
-    return oldset;
+    mask_cache &cached = cache();
+    if (!cached.valid)
+    {
+        ::sigset_t handle;
+        ::pthread_sigmask(SIG_UNBLOCK, nullptr, &handle);
+        cached.mask = sigset(handle).mask();
+        cached.valid = true;
+    }
+    return sigset::from_mask(cached.mask);
 }
 }  // namespace impl
 
@@ -200,9 +397,20 @@ inline sigset set_mask(const sigset &newset) noexcept
     return impl::set_mask(SIG_SETMASK, newset);
 }
 
+// Re-reads the mask from the kernel.  Needed only after the mask was changed
+// without psig, e.g. by calling pthread_sigmask() directly.
+inline sigset refresh_mask() noexcept
+{
+    impl::cache().valid = false;
+    return impl::get_mask();
+}
+
+// Blocks every signal except the ones raised synchronously by faults, which
+// kill the process when they arrive blocked.
 inline sigset fill_mask() noexcept
 {
-    return impl::set_mask(SIG_SETMASK, sigset(true));
+    return impl::set_mask(SIG_SETMASK,
+                          ~sigset{SIGBUS, SIGFPE, SIGILL, SIGSEGV});
 }
 inline sigset clear_mask() noexcept
 {
@@ -226,6 +434,26 @@ inline sigset sub_mask(const signum_t signum) noexcept
 {
     return sub_mask(sigset(signum));
 }
+
+// Sets the thread's mask for the guard's lifetime.  Neither the change nor
+// the restore makes a syscall when the mask already matches.
+class scoped_mask
+{
+   public:
+    explicit scoped_mask(const sigset &mask) noexcept
+        : m_previous(set_mask(mask))
+    {
+    }
+    ~scoped_mask() noexcept { set_mask(m_previous); }
+
+    scoped_mask(const scoped_mask &) = delete;
+    scoped_mask &operator=(const scoped_mask &) = delete;
+
+    const sigset &previous() const noexcept { return m_previous; }
+
+   private:
+    sigset m_previous;
+};
 }  // namespace this_thread
 
 namespace this_process
@@ -239,23 +467,14 @@ inline void set_action(const sigset &signals)
     action.sa_handler = &::psig_signal_handler;
     action.sa_flags = 0;
 
-    for (signum_t signal : signals.signals())
+    for (signum_t signal : signals)
         ::sigaction(signal, &action, nullptr);
 }
 }  // namespace this_process
 
-inline signum_t wait(const sigset &signals, ::siginfo_t *info = nullptr)
+namespace impl
 {
-    this_process::set_action(signals);
-    const sigset oldset = this_thread::set_mask(signals);
-    const signum_t signum = ::sigwaitinfo(signals.native_handle(), info);
-    this_thread::set_mask(oldset);
-    return signum;
-}
-
-inline signum_t wait(const sigset &signals,
-                     std::chrono::nanoseconds timeout,
-                     ::siginfo_t *info = nullptr)
+inline ::timespec to_timespec(const std::chrono::nanoseconds &timeout)
 {
     ::timespec ts;
     ts.tv_sec =
@@ -264,203 +483,1855 @@ inline signum_t wait(const sigset &signals,
         ts.tv_nsec = timeout.count() - (ts.tv_sec * std::nano().den);
     else
         ts.tv_nsec = timeout.count();
-
-    this_process::set_action(signals);
-    const sigset oldset = this_thread::set_mask(signals);
-    const signum_t signum = ::sigtimedwait(signals.native_handle(), info, &ts);
-    this_thread::set_mask(oldset);
-    return signum;
+    return ts;
 }
+}  // namespace impl
 
-class signal_manager
+// A signalfd(2) for a set of signals.  The signals must stay blocked in every
+// thread for the descriptor to see them; each read() is a single syscall.
+class signal_fd
 {
    public:
-    static inline bool block_signals(
-        const std::chrono::nanoseconds &timeout_nsec =
-            std::chrono::nanoseconds(0))
-    {
-        return instance().block_signals_internal(timeout_nsec);
-    }
+    typedef int native_handle_type;
 
-    static inline bool block_signals(
-        const sigset &signals,
-        const std::chrono::nanoseconds &timeout_nsec =
-            std::chrono::nanoseconds(0))
+    signal_fd() noexcept : m_fd(-1) {}
+    explicit signal_fd(const sigset &signals,
+                       const int flags = SFD_CLOEXEC) noexcept
+        : m_fd(-1)
     {
-        return instance().block_signals_internal(signals, timeout_nsec);
+        open(signals, flags);
     }
+    signal_fd(signal_fd &&that) noexcept : m_fd(that.m_fd) { that.m_fd = -1; }
+    ~signal_fd() noexcept { close(); }
 
-    static inline int exec(const std::function< bool(int)> &signalHandler,
-                           const std::function< int() > &exitHandler)
-    {
-        return instance().exec_internal(signalHandler, exitHandler);
-    }
+    signal_fd(const signal_fd &) = delete;
+    signal_fd &operator=(const signal_fd &) = delete;
 
-    static inline int exec(const std::function< bool(int)> &signalHandler)
+    signal_fd &operator=(signal_fd &&that) noexcept
     {
-        return exec(signalHandler, &signal_manager::default_exit_handler);
+        if (this != &that)
+        {
+            close();
+            m_fd = that.m_fd;
+            that.m_fd = -1;
+        }
+        return *this;
     }
 
-    static inline int exec(const std::function< int() > &exitHandler)
+    // Opens the descriptor, or changes the watched set if already open.
+    bool open(const sigset &signals, const int flags = SFD_CLOEXEC) noexcept
     {
-        return exec(&signal_manager::default_signal_handler, exitHandler);
-    }
+        const ::sigset_t handle = signals.native_handle();
+        const int fd = ::signalfd(m_fd, &handle, flags);
+        if (fd < 0)
+            return false;
 
-    static inline int exec()
-    {
-        return exec(&signal_manager::default_signal_handler,
-                    &signal_manager::default_exit_handler);
-    }
-    
-    static inline void exec_async(const std::function< bool(int)> &signalHandler,
-                           const std::function< int() > &exitHandler)
-    {
-        instance().exec_async_internal(signalHandler, exitHandler);
+        // an open descriptor keeps its number, and a thread may be reading it
+        if (m_fd < 0)
+            m_fd = fd;
+        return true;
     }
 
-    static inline void exec_async(const std::function< bool(int)> &signalHandler)
+    void close() noexcept
     {
-        exec_async(signalHandler, &signal_manager::default_exit_handler);
+        if (m_fd >= 0)
+        {
+            ::close(m_fd);
+            m_fd = -1;
+        }
     }
 
-    static inline void exec_async(const std::function< int() > &exitHandler)
-    {
-        exec_async(&signal_manager::default_signal_handler, exitHandler);
-    }
+    bool is_open() const noexcept { return (m_fd >= 0); }
+    native_handle_type native_handle() const noexcept { return m_fd; }
 
-    static inline void exec_async()
-    {
-        exec_async(&signal_manager::default_signal_handler,
-                    &signal_manager::default_exit_handler);
-    }
-    
-    static inline void wait_for_exec_async()
+    signum_t read(::siginfo_t *info = nullptr) noexcept
     {
-        instance().wait_for_exec_async_internal();
-    }
-
-    static inline void kill(int sig = SIGINT) { ::kill(0, sig); }
+        ::signalfd_siginfo record;
+        const ::ssize_t bytes = ::read(m_fd, &record, sizeof(record));
+        if (bytes != static_cast< ::ssize_t >(sizeof(record)))
+            return -1;
 
-    static inline void stop(int sig = SIGINT) { instance().stop_internal(sig); }
-    
-    static inline int exit_code() { return instance().exit_code_internal(); }
+        if (info)
+            to_siginfo(record, info);
+        return static_cast< signum_t >(record.ssi_signo);
+    }
 
-   private:
-    static inline signal_manager &instance()
+    // Reads as many pending records as fit in a single syscall.
+    ::ssize_t read(::siginfo_t *infos, const std::size_t count) noexcept
     {
-        static signal_manager mgr;
-        return mgr;
-    }
+        const ::ssize_t bytes = ::read(m_fd, infos, count * sizeof(*infos));
+        if (bytes < 0)
+            return -1;
 
-    inline signal_manager() : m_running(false), m_exit_code(0) {}
-    signal_manager(const signal_manager &rhs) = delete;
-    signal_manager &operator=(const signal_manager &rhs) = delete;
+        const ::ssize_t records = bytes / sizeof(::signalfd_siginfo);
+        to_siginfo(infos, records);
+        return records;
+    }
 
-    inline bool block_signals_internal(
-        const std::chrono::nanoseconds &timeout_nsec =
-            std::chrono::nanoseconds(0))
+    // Converts records that were read into a siginfo_t array in place.
+    static void to_siginfo(::siginfo_t *infos, const std::size_t records) noexcept
     {
-        m_timeout_nsec = timeout_nsec;
+        static_assert(sizeof(::signalfd_siginfo) == sizeof(::siginfo_t),
+                      "records are converted in place");
 
-        this_thread::fill_mask();
+        for (std::size_t i = 0; i < records; ++i)
+        {
+            ::signalfd_siginfo record;
+            std::memcpy(&record, &infos[i], sizeof(record));
+            to_siginfo(record, &infos[i]);
+        }
+    }
 
-        m_signals += SIGHUP;
-        m_signals += SIGINT;
-        m_signals += SIGTERM;
+    static void to_siginfo(const ::signalfd_siginfo &record,
+                           ::siginfo_t *info) noexcept
+    {
+        std::memset(info, 0, sizeof(*info));
+        info->si_signo = record.ssi_signo;
+        info->si_errno = record.ssi_errno;
+        info->si_code = record.ssi_code;
 
-        m_running = true;
-        return true;
+        if (record.ssi_code == SI_TIMER)
+        {
+            info->si_timerid = record.ssi_tid;
+            info->si_overrun = record.ssi_overrun;
+            info->si_value.sival_ptr =
+                reinterpret_cast< void * >(record.ssi_ptr);
+        }
+        else if (record.ssi_signo == SIGCHLD && record.ssi_code > 0)
+        {
+            info->si_pid = record.ssi_pid;
+            info->si_uid = record.ssi_uid;
+            info->si_status = record.ssi_status;
+            info->si_utime = record.ssi_utime;
+            info->si_stime = record.ssi_stime;
+        }
+        else if ((record.ssi_signo == SIGSEGV || record.ssi_signo == SIGBUS ||
+                  record.ssi_signo == SIGILL || record.ssi_signo == SIGFPE ||
+                  record.ssi_signo == SIGTRAP) &&
+                 record.ssi_code > 0)
+        {
+            info->si_addr = reinterpret_cast< void * >(record.ssi_addr);
+        }
+        else
+        {
+            info->si_pid = record.ssi_pid;
+            info->si_uid = record.ssi_uid;
+            info->si_value.sival_ptr =
+                reinterpret_cast< void * >(record.ssi_ptr);
+        }
     }
 
-    inline bool block_signals_internal(
-        const sigset &signals,
-        const std::chrono::nanoseconds &timeout_nsec =
-            std::chrono::nanoseconds(0))
-    {
-        m_timeout_nsec = timeout_nsec;
+   private:
+    int m_fd;
+};
 
-        this_thread::fill_mask();
+// An eventfd(2) used to wake an application's poll/epoll loop.
+class event_fd
+{
+   public:
+    typedef int native_handle_type;
 
-        m_signals = signals;
+    event_fd() noexcept : m_fd(-1) {}
+    event_fd(event_fd &&that) noexcept : m_fd(that.m_fd) { that.m_fd = -1; }
+    ~event_fd() noexcept { close(); }
 
-        m_running = true;
-        return true;
-    }
+    event_fd(const event_fd &) = delete;
+    event_fd &operator=(const event_fd &) = delete;
 
-    inline int exec_internal(const std::function< bool(int)> &signalHandler,
-                             const std::function< int() > &exitHandler)
+    event_fd &operator=(event_fd &&that) noexcept
     {
-        while (m_running)
+        if (this != &that)
         {
-            ::siginfo_t info;
-            signum_t signum;
-
-            if (m_timeout_nsec > std::chrono::nanoseconds(0))
-            {
-                signum = wait(m_signals, m_timeout_nsec, &info);
-            }
-            else
-            {
-                signum = wait(m_signals, &info);
-            }
-
-            if (signum > 0)
-            {
-                if (!signalHandler(signum))
-                {
-                    m_running = false;
-                }
-            }
+            close();
+            m_fd = that.m_fd;
+            that.m_fd = -1;
         }
-
-        m_exit_code = exitHandler();
-        return m_exit_code;
-    }
-    
-    inline void exec_internal_noret(const std::function< bool(int)> &signalHandler,
-                             const std::function< int() > &exitHandler)
-    {
-        exec_internal(signalHandler, exitHandler);
+        return *this;
     }
-    
-    inline void exec_async_internal(const std::function< bool(int)> &signalHandler,
-                             const std::function< int() > &exitHandler)
+
+    bool open(const int flags = EFD_CLOEXEC | EFD_NONBLOCK) noexcept
     {
-        m_thread.reset(new std::thread(std::bind(&signal_manager::exec_internal_noret, this, signalHandler, exitHandler)));
+        if (m_fd >= 0)
+            return true;
+
+        m_fd = ::eventfd(0, flags);
+        return (m_fd >= 0);
     }
-    
-    inline void wait_for_exec_async_internal()
+
+    void close() noexcept
     {
-        if (m_thread)
+        if (m_fd >= 0)
         {
-            m_thread->join();
+            ::close(m_fd);
+            m_fd = -1;
         }
     }
 
-    inline void stop_internal(int sig = SIGINT)
+    bool is_open() const noexcept { return (m_fd >= 0); }
+    native_handle_type native_handle() const noexcept { return m_fd; }
+
+    bool notify(const std::uint64_t count = 1) noexcept
     {
-        m_running = false;
-        ::kill(0, sig);
-        
-        if (m_thread)
-        {
-            m_thread->join();
-        }
-    }
-    
-    inline int exit_code_internal() { return m_exit_code; }
+        if (m_fd < 0)
+            return false;
 
-   private:
-    static inline int default_exit_handler() { return 0; }
+        return (::write(m_fd, &count, sizeof(count)) == sizeof(count));
+    }
 
-    static inline bool default_signal_handler(int sig) { return false; }
+    // Returns the number of notifications since the last call, or 0.
+    std::uint64_t consume() noexcept
+    {
+        std::uint64_t count = 0;
+        if (m_fd < 0 || ::read(m_fd, &count, sizeof(count)) != sizeof(count))
+            return 0;
+        return count;
+    }
 
    private:
-    sigset m_signals;
-    std::atomic< bool > m_running;
-    std::chrono::nanoseconds m_timeout_nsec;
-    std::unique_ptr< std::thread > m_thread;
-    int m_exit_code;
+    int m_fd;
+};
+
+inline signum_t wait(const sigset &signals, ::siginfo_t *info = nullptr)
+{
+    this_process::set_action(signals);
+    const sigset oldset = this_thread::add_mask(signals);
+    const ::sigset_t handle = signals.native_handle();
+    const signum_t signum = ::sigwaitinfo(&handle, info);
+    this_thread::set_mask(oldset);
+    return signum;
+}
+
+inline signum_t wait(const sigset &signals,
+                     std::chrono::nanoseconds timeout,
+                     ::siginfo_t *info = nullptr)
+{
+    const ::timespec ts = impl::to_timespec(timeout);
+
+    this_process::set_action(signals);
+    const sigset oldset = this_thread::add_mask(signals);
+    const ::sigset_t handle = signals.native_handle();
+    const signum_t signum = ::sigtimedwait(&handle, info, &ts);
+    this_thread::set_mask(oldset);
+    return signum;
+}
+
+inline signum_t wait(signal_fd &fd, ::siginfo_t *info = nullptr)
+{
+    return fd.read(info);
+}
+
+inline signum_t wait(signal_fd &fd,
+                     std::chrono::nanoseconds timeout,
+                     ::siginfo_t *info = nullptr)
+{
+    const ::timespec ts = impl::to_timespec(timeout);
+
+    ::pollfd pfd;
+    pfd.fd = fd.native_handle();
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    const int ready = ::ppoll(&pfd, 1, &ts, nullptr);
+    if (ready <= 0)
+    {
+        if (ready == 0)
+            errno = EAGAIN;
+        return -1;
+    }
+
+    return fd.read(info);
+}
+
+namespace impl
+{
+inline ::ssize_t drain(const ::sigset_t &handle,
+                       const signum_t first,
+                       ::siginfo_t *infos,
+                       const std::size_t count)
+{
+    if (first <= 0)
+        return -1;
+
+    const ::timespec zero = {0, 0};
+    std::size_t received = 1;
+    while (received < count &&
+           ::sigtimedwait(&handle, &infos[received], &zero) > 0)
+        ++received;
+    return static_cast< ::ssize_t >(received);
+}
+}  // namespace impl
+
+inline ::ssize_t wait_batch(const sigset &signals,
+                            ::siginfo_t *infos,
+                            const std::size_t count)
+{
+    if (count == 0)
+        return 0;
+
+    this_process::set_action(signals);
+    const sigset oldset = this_thread::add_mask(signals);
+    const ::sigset_t handle = signals.native_handle();
+    const ::ssize_t received =
+        impl::drain(handle, ::sigwaitinfo(&handle, &infos[0]), infos, count);
+    this_thread::set_mask(oldset);
+    return received;
+}
+
+inline ::ssize_t wait_batch(const sigset &signals,
+                            std::chrono::nanoseconds timeout,
+                            ::siginfo_t *infos,
+                            const std::size_t count)
+{
+    if (count == 0)
+        return 0;
+
+    const ::timespec ts = impl::to_timespec(timeout);
+
+    this_process::set_action(signals);
+    const sigset oldset = this_thread::add_mask(signals);
+    const ::sigset_t handle = signals.native_handle();
+    const ::ssize_t received = impl::drain(
+        handle, ::sigtimedwait(&handle, &infos[0], &ts), infos, count);
+    this_thread::set_mask(oldset);
+    return received;
+}
+
+inline ::ssize_t wait_batch(signal_fd &fd,
+                            ::siginfo_t *infos,
+                            const std::size_t count)
+{
+    return fd.read(infos, count);
+}
+
+inline ::ssize_t wait_batch(signal_fd &fd,
+                            std::chrono::nanoseconds timeout,
+                            ::siginfo_t *infos,
+                            const std::size_t count)
+{
+    const ::timespec ts = impl::to_timespec(timeout);
+
+    ::pollfd pfd;
+    pfd.fd = fd.native_handle();
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    const int ready = ::ppoll(&pfd, 1, &ts, nullptr);
+    if (ready <= 0)
+    {
+        if (ready == 0)
+            errno = EAGAIN;
+        return -1;
+    }
+
+    return fd.read(infos, count);
+}
+
+class handler_table
+{
+   public:
+    typedef std::function< bool(int) > handler_type;
+
+    bool set(const signum_t signum, const handler_type &handler)
+    {
+        if (signum <= 0 || signum >= _NSIG)
+            return false;
+
+        m_handlers[signum] = handler;
+        m_signals += signum;
+        return true;
+    }
+
+    void erase(const signum_t signum)
+    {
+        if (signum <= 0 || signum >= _NSIG)
+            return;
+
+        m_handlers[signum] = nullptr;
+        m_signals -= signum;
+    }
+
+    bool has(const signum_t signum) const noexcept
+    {
+        return m_signals.has(signum);
+    }
+
+    const sigset &signals() const noexcept { return m_signals; }
+
+    // Unregistered signals report false, which stops the signal manager.
+    bool operator()(const signum_t signum) const
+    {
+        if (!m_signals.has(signum))
+            return false;
+
+        return m_handlers[signum](signum);
+    }
+
+   private:
+    std::array< handler_type, _NSIG > m_handlers;
+    sigset m_signals;
+};
+
+// A handler_table that can be changed while a loop dispatches from it.
+// Writers copy the current table, modify the copy and publish it with one
+// atomic exchange; the single reader dispatches through one acquire load and
+// frees replaced tables from quiesce(), when it holds no table.  A signal
+// whose handler was erased stays in the loop's wait set, so it is consumed
+// rather than reported as unregistered.
+class shared_handler_table
+{
+   public:
+    typedef handler_table::handler_type handler_type;
+
+    inline shared_handler_table()
+        : m_current(new node())
+        , m_retired(nullptr)
+    {
+    }
+
+    inline ~shared_handler_table()
+    {
+        quiesce();
+        delete m_current.load(std::memory_order_relaxed);
+    }
+
+    shared_handler_table(const shared_handler_table &) = delete;
+    shared_handler_table &operator=(const shared_handler_table &) = delete;
+
+    inline bool set(const signum_t signum, const handler_type &handler)
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+
+        std::unique_ptr< node > next(new node(current()));
+        if (!next->table.set(signum, handler))
+            return false;
+
+        next->erased -= signum;
+        publish(next.release());
+        return true;
+    }
+
+    inline void erase(const signum_t signum)
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+
+        if (signum <= 0 || signum >= _NSIG)
+            return;
+
+        std::unique_ptr< node > next(new node(current()));
+        next->table.erase(signum);
+        next->erased += signum;
+        publish(next.release());
+    }
+
+    // Replaces every handler at once; a signal is dispatched either by the
+    // old table or by the new one, never by neither.  Signals the new table
+    // drops count as erased.
+    inline void replace(const handler_table &table)
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+
+        node *next = new node(table);
+        next->erased = (current().erased | current().table.signals()) &
+                       ~table.signals();
+        publish(next);
+    }
+
+    inline handler_table snapshot() const
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        return current().table;
+    }
+
+    inline sigset signals() const
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        return current().table.signals();
+    }
+
+    // Reader side: only one thread may dispatch and quiesce.
+    inline bool operator()(const signum_t signum) const
+    {
+        const node *n = m_current.load(std::memory_order_acquire);
+        if (n->erased.has(signum))
+            return true;
+
+        return n->table(signum);
+    }
+
+    inline void quiesce()
+    {
+        if (m_retired.load(std::memory_order_relaxed) == nullptr)
+            return;
+
+        node *retired = m_retired.exchange(nullptr, std::memory_order_acquire);
+        while (retired != nullptr)
+        {
+            node *next = retired->next;
+            delete retired;
+            retired = next;
+        }
+    }
+
+   private:
+    struct node
+    {
+        inline node() : next(nullptr) {}
+        inline explicit node(const handler_table &t)
+            : table(t)
+            , next(nullptr)
+        {
+        }
+        inline node(const node &that)
+            : table(that.table)
+            , erased(that.erased)
+            , next(nullptr)
+        {
+        }
+
+        handler_table table;
+        sigset erased;
+        node *next;
+    };
+
+    inline const node &current() const
+    {
+        return *m_current.load(std::memory_order_relaxed);
+    }
+
+    inline void publish(node *next)
+    {
+        node *old = m_current.exchange(next, std::memory_order_acq_rel);
+
+        old->next = m_retired.load(std::memory_order_relaxed);
+        while (!m_retired.compare_exchange_weak(old->next,
+                                                old,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed))
+        {
+        }
+    }
+
+   private:
+    mutable std::mutex m_mutex;
+    std::atomic< node * > m_current;
+    std::atomic< node * > m_retired;
+};
+
+template < signum_t Signum, typename Handler >
+struct static_handler
+{
+    static constexpr signum_t signum = Signum;
+    Handler handler;
+};
+
+template < signum_t Signum, typename Handler >
+constexpr signum_t static_handler< Signum, Handler >::signum;
+
+template < signum_t Signum, typename Handler >
+inline static_handler< Signum, typename std::decay< Handler >::type > on(
+    Handler &&handler)
+{
+    return {std::forward< Handler >(handler)};
+}
+
+namespace impl
+{
+template < std::size_t... Is >
+struct index_sequence
+{
+};
+
+template < std::size_t N, std::size_t... Is >
+struct make_index_sequence : make_index_sequence< N - 1, N - 1, Is... >
+{
+};
+
+template < std::size_t... Is >
+struct make_index_sequence< 0, Is... > : index_sequence< Is... >
+{
+};
+
+template < std::size_t Signum, std::size_t I, typename... Handlers >
+struct handler_index : std::integral_constant< std::size_t, I >
+{
+};
+
+template < std::size_t Signum,
+           std::size_t I,
+           typename Handler,
+           typename... Handlers >
+struct handler_index< Signum, I, Handler, Handlers... >
+    : std::conditional<
+          static_cast< std::size_t >(Handler::signum) == Signum,
+          std::integral_constant< std::size_t, I >,
+          handler_index< Signum, I + 1, Handlers... > >::type
+{
+};
+}  // namespace impl
+
+// Dispatches through a table of thunks built at compile time from
+// static_handler entries, so no handler is called through std::function.
+template < typename... Handlers >
+class static_dispatcher
+{
+   public:
+    explicit static_dispatcher(Handlers... handlers)
+        : m_handlers(std::move(handlers)...)
+    {
+    }
+
+    static constexpr sigset signals() { return sigset{Handlers::signum...}; }
+
+    bool operator()(const signum_t signum)
+    {
+        if (signum <= 0 || signum >= _NSIG)
+            return false;
+
+        return s_table[signum](*this, signum);
+    }
+
+   private:
+    typedef bool (*thunk_type)(static_dispatcher &, signum_t);
+    typedef std::array< thunk_type, _NSIG > table_type;
+
+    template < std::size_t I, bool Found = (I < sizeof...(Handlers)) >
+    struct thunk
+    {
+        static bool invoke(static_dispatcher &dispatcher, signum_t signum)
+        {
+            return std::get< I >(dispatcher.m_handlers).handler(signum);
+        }
+    };
+
+    template < std::size_t I >
+    struct thunk< I, false >
+    {
+        static bool invoke(static_dispatcher &, signum_t) { return false; }
+    };
+
+    template < std::size_t... Signums >
+    static constexpr table_type make_table(impl::index_sequence< Signums... >)
+    {
+        return {{&thunk< impl::handler_index< Signums, 0, Handlers... >::
+                             value >::invoke...}};
+    }
+
+    static constexpr table_type s_table =
+        make_table(impl::make_index_sequence< _NSIG >());
+
+    std::tuple< Handlers... > m_handlers;
+};
+
+template < typename... Handlers >
+constexpr typename static_dispatcher< Handlers... >::table_type
+    static_dispatcher< Handlers... >::s_table;
+
+template < typename... Handlers >
+inline static_dispatcher< Handlers... > make_dispatcher(Handlers... handlers)
+{
+    return static_dispatcher< Handlers... >(std::move(handlers)...);
+}
+
+// Log2 buckets of nanoseconds: bucket i counts samples in [2^i, 2^(i+1)), the
+// last bucket also counts everything larger.
+struct histogram
+{
+    static const std::size_t buckets = 32;
+    typedef std::array< std::uint64_t, buckets > counts_type;
+
+    static std::size_t bucket(const std::uint64_t nsec) noexcept
+    {
+        const std::size_t b = 63 - __builtin_clzll(nsec | 1);
+        return (b < buckets) ? b : buckets - 1;
+    }
+
+    counts_type counts;
+
+    std::uint64_t total() const noexcept
+    {
+        std::uint64_t sum = 0;
+        for (std::uint64_t count : counts) sum += count;
+        return sum;
+    }
+};
+
+struct signal_stats
+{
+    std::uint64_t delivered;
+    std::uint64_t coalesced;  // estimate, from timer overruns
+    histogram handler_nsec;
+    histogram queue_wait_nsec;  // only for timestamped signals
+};
+
+class stats_snapshot
+{
+   public:
+    const signal_stats &operator[](const signum_t signum) const noexcept
+    {
+        return m_stats[(signum > 0 && signum < _NSIG) ? signum : 0];
+    }
+
+    std::uint64_t delivered() const noexcept
+    {
+        std::uint64_t sum = 0;
+        for (const signal_stats &stats : m_stats) sum += stats.delivered;
+        return sum;
+    }
+
+   private:
+    friend class signal_statistics;
+
+    std::array< signal_stats, _NSIG > m_stats;
+};
+
+namespace rt
+{
+// A sigval holding the current CLOCK_MONOTONIC time, for signals that
+// signal_statistics treats as timestamped.
+inline ::sigval timestamp() noexcept
+{
+    ::sigval value;
+    value.sival_ptr = reinterpret_cast< void * >(static_cast< std::uintptr_t >(
+        std::chrono::duration_cast< std::chrono::nanoseconds >(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count()));
+    return value;
+}
+}  // namespace rt
+
+// Per-signal counters written only by the thread running the dispatch loop and
+// read with relaxed loads, so a snapshot never stops the loop.
+class signal_statistics
+{
+   public:
+    typedef std::chrono::steady_clock clock_type;
+
+    signal_statistics() noexcept : m_timestamped(0)
+    {
+        for (counters &c : m_counters)
+        {
+            c.delivered.store(0, std::memory_order_relaxed);
+            c.coalesced.store(0, std::memory_order_relaxed);
+            for (std::atomic< std::uint64_t > &count : c.handler_nsec)
+                count.store(0, std::memory_order_relaxed);
+            for (std::atomic< std::uint64_t > &count : c.queue_wait_nsec)
+                count.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    signal_statistics(const signal_statistics &) = delete;
+    signal_statistics &operator=(const signal_statistics &) = delete;
+
+    // Signals queued with rt::timestamp() as their value, for which the
+    // queue-wait time is recorded.
+    void set_timestamped(const sigset &signals) noexcept
+    {
+        m_timestamped.store(signals.mask(), std::memory_order_relaxed);
+    }
+
+    void record(const ::siginfo_t &info,
+                const clock_type::time_point &start,
+                const clock_type::time_point &finish) noexcept
+    {
+        const signum_t signum = info.si_signo;
+        if (signum <= 0 || signum >= _NSIG)
+            return;
+
+        counters &c = m_counters[signum];
+        increment(c.delivered);
+
+        if (info.si_code == SI_TIMER && info.si_overrun > 0)
+            increment(c.coalesced, info.si_overrun);
+
+        increment(c.handler_nsec[histogram::bucket(elapsed(start, finish))]);
+
+        if (info.si_code == SI_QUEUE &&
+            (m_timestamped.load(std::memory_order_relaxed) &
+             sigset(signum).mask()))
+        {
+            const std::int64_t sent = static_cast< std::int64_t >(
+                reinterpret_cast< std::uintptr_t >(info.si_value.sival_ptr));
+            const std::int64_t received =
+                std::chrono::duration_cast< std::chrono::nanoseconds >(
+                    start.time_since_epoch())
+                    .count();
+            increment(c.queue_wait_nsec[histogram::bucket(
+                (received > sent) ? received - sent : 0)]);
+        }
+    }
+
+    stats_snapshot snapshot() const noexcept
+    {
+        stats_snapshot snap;
+        for (std::size_t signum = 0; signum < m_counters.size(); ++signum)
+        {
+            const counters &c = m_counters[signum];
+            signal_stats &stats = snap.m_stats[signum];
+
+            stats.delivered = c.delivered.load(std::memory_order_relaxed);
+            stats.coalesced = c.coalesced.load(std::memory_order_relaxed);
+            for (std::size_t b = 0; b < histogram::buckets; ++b)
+            {
+                stats.handler_nsec.counts[b] =
+                    c.handler_nsec[b].load(std::memory_order_relaxed);
+                stats.queue_wait_nsec.counts[b] =
+                    c.queue_wait_nsec[b].load(std::memory_order_relaxed);
+            }
+        }
+        return snap;
+    }
+
+   private:
+    struct counters
+    {
+        std::atomic< std::uint64_t > delivered;
+        std::atomic< std::uint64_t > coalesced;
+        std::atomic< std::uint64_t > handler_nsec[histogram::buckets];
+        std::atomic< std::uint64_t > queue_wait_nsec[histogram::buckets];
+    };
+
+    static void increment(std::atomic< std::uint64_t > &count,
+                          const std::uint64_t n = 1) noexcept
+    {
+        count.store(count.load(std::memory_order_relaxed) + n,
+                    std::memory_order_relaxed);
+    }
+
+    static std::uint64_t elapsed(const clock_type::time_point &start,
+                                 const clock_type::time_point &finish) noexcept
+    {
+        return std::chrono::duration_cast< std::chrono::nanoseconds >(finish -
+                                                                     start)
+            .count();
+    }
+
+   private:
+    std::array< counters, _NSIG > m_counters;
+    std::atomic< sigset::mask_type > m_timestamped;
+};
+
+// Scheduling, placement and naming for the thread that runs a signal loop.
+// Unset fields are inherited from the creating thread.
+struct thread_options
+{
+    inline thread_options() : policy(-1), priority(0), stack_size(0) {}
+
+    std::vector< int > cpus;  // empty: inherit the affinity mask
+    int policy;               // SCHED_FIFO, SCHED_RR, ...; -1: inherit
+    int priority;
+    std::size_t stack_size;  // 0: default; only used for new threads
+    std::string name;        // at most 15 characters are kept
+
+    // Applies everything but the stack size to the calling thread.  Returns
+    // 0 or the error of the first setting that could not be applied.
+    inline int apply() const
+    {
+        const ::pthread_t self = ::pthread_self();
+
+        if (!cpus.empty())
+        {
+            ::cpu_set_t set;
+            CPU_ZERO(&set);
+            for (int cpu : cpus)
+                if (cpu >= 0 && cpu < CPU_SETSIZE)
+                    CPU_SET(cpu, &set);
+
+            const int rc = ::pthread_setaffinity_np(self, sizeof(set), &set);
+            if (rc != 0)
+                return rc;
+        }
+
+        if (policy >= 0)
+        {
+            ::sched_param param;
+            std::memset(&param, 0, sizeof(param));
+            param.sched_priority = priority;
+
+            const int rc = ::pthread_setschedparam(self, policy, &param);
+            if (rc != 0)
+                return rc;
+        }
+
+        if (!name.empty())
+        {
+            const int rc =
+                ::pthread_setname_np(self, name.substr(0, 15).c_str());
+            if (rc != 0)
+                return rc;
+        }
+
+        return 0;
+    }
+};
+
+namespace impl
+{
+// A small per-thread number, used to spread threads over per-thread slots.
+inline std::size_t thread_index()
+{
+    static std::atomic< std::size_t > next(0);
+    static thread_local const std::size_t index = next.fetch_add(1);
+    return index;
+}
+
+// One realtime signal, reserved on first use and shared by every loop, that
+// request_stop() sends to a single loop thread to wake it.
+inline signum_t wake_signal()
+{
+    static const signum_t signum = rt::reserve();
+    return signum;
+}
+
+// The object that an asynchronous signal handler serves, per signal.  The
+// handler looks its owner up through a scope, and reset() waits for every
+// scope to end, so an owner is never used after it has been destroyed.
+template < typename T >
+class signal_owner
+{
+   public:
+    static const int max_signum = 65;
+
+    class scope
+    {
+       public:
+        explicit scope(const int signum) noexcept : m_owner(nullptr)
+        {
+            active().fetch_add(1);
+            if (signum > 0 && signum < max_signum)
+                m_owner = table()[signum].load();
+        }
+        ~scope() noexcept { active().fetch_sub(1); }
+
+        scope(const scope &) = delete;
+        scope &operator=(const scope &) = delete;
+
+        T *get() const noexcept { return m_owner; }
+
+       private:
+        T *m_owner;
+    };
+
+    static bool set(const int signum, T *owner) noexcept
+    {
+        if (signum <= 0 || signum >= max_signum)
+            return false;
+        table()[signum].store(owner);
+        return true;
+    }
+
+    static void reset(const int signum) noexcept
+    {
+        if (signum <= 0 || signum >= max_signum)
+            return;
+
+        table()[signum].store(nullptr);
+        while (active().load() != 0)
+            std::this_thread::yield();
+    }
+
+   private:
+    static std::atomic< T * > *table() noexcept
+    {
+        static std::atomic< T * > owners[max_signum];
+        return owners;
+    }
+
+    static std::atomic< int > &active() noexcept
+    {
+        static std::atomic< int > count(0);
+        return count;
+    }
+};
+
+// A joinable thread with a configurable stack size, which std::thread does
+// not offer.
+class thread
+{
+   public:
+    inline thread(const std::function< void() > &fn,
+                  const std::size_t stack_size)
+        : m_joinable(false)
+        , m_error(0)
+    {
+        ::pthread_attr_t attr;
+        ::pthread_attr_init(&attr);
+
+        if (stack_size > 0)
+        {
+            const std::size_t minimum =
+                static_cast< std::size_t >(PTHREAD_STACK_MIN);
+            m_error = ::pthread_attr_setstacksize(
+                &attr, stack_size < minimum ? minimum : stack_size);
+        }
+
+        if (m_error == 0)
+        {
+            std::function< void() > *arg = new std::function< void() >(fn);
+            m_error = ::pthread_create(&m_handle, &attr, &thread::run, arg);
+            if (m_error == 0)
+                m_joinable = true;
+            else
+                delete arg;
+        }
+
+        ::pthread_attr_destroy(&attr);
+    }
+
+    inline ~thread()
+    {
+        if (m_joinable)
+            ::pthread_detach(m_handle);
+    }
+
+    thread(const thread &) = delete;
+    thread &operator=(const thread &) = delete;
+
+    inline bool joinable() const { return m_joinable; }
+
+    inline int error() const { return m_error; }
+
+    inline void join()
+    {
+        if (m_joinable)
+        {
+            ::pthread_join(m_handle, nullptr);
+            m_joinable = false;
+        }
+    }
+
+   private:
+    static inline void *run(void *arg)
+    {
+        std::unique_ptr< std::function< void() > > fn(
+            static_cast< std::function< void() > * >(arg));
+        (*fn)();
+        return nullptr;
+    }
+
+   private:
+    ::pthread_t m_handle;
+    bool m_joinable;
+    int m_error;
+};
+}  // namespace impl
+
+// An instantiable signal manager: one set of signals, one handler registry
+// and (for exec_async) one thread.  Several loops can serve disjoint signal
+// sets in parallel; signal_manager is the process-wide default loop.
+class signal_loop
+{
+   public:
+    enum class backend
+    {
+        sigwait,
+        signalfd
+    };
+
+    typedef std::function< bool(const siginfo_span &) > batch_handler_type;
+
+    inline signal_loop()
+        : m_running(false)
+        , m_finished(false)
+        , m_tid(0)
+        , m_changed(false)
+        , m_wake(impl::wake_signal())
+        , m_wake_shared(false)
+        , m_backend(backend::sigwait)
+        , m_batch_size(64)
+        , m_timeout_nsec(0)
+        , m_thread_error(0)
+        , m_exit_code(0)
+    {
+    }
+
+    inline ~signal_loop()
+    {
+        if (m_thread && m_thread->joinable())
+        {
+            stop();
+        }
+    }
+
+    signal_loop(const signal_loop &rhs) = delete;
+    signal_loop &operator=(const signal_loop &rhs) = delete;
+
+    inline void set_backend(const backend type)
+    {
+        m_backend = type;
+
+        if (m_running)
+        {
+            open_backend();
+        }
+    }
+
+    inline int fd() const { return m_fd.native_handle(); }
+
+    inline sigset signals() const
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        return m_signals;
+    }
+
+    // Applied to the thread started by exec_async() and exec_batch_async(),
+    // or to the calling thread by exec() and exec_batch().
+    inline void set_thread_options(const thread_options &options)
+    {
+        m_thread_options = options;
+    }
+
+    // 0, or the error from starting the loop thread or applying its
+    // thread_options.  Valid once the loop has started.
+    inline int thread_error() const { return m_thread_error; }
+
+    inline bool block_signals(const std::chrono::nanoseconds &timeout_nsec =
+                                  std::chrono::nanoseconds(0))
+    {
+        m_timeout_nsec = timeout_nsec;
+
+        this_thread::fill_mask();
+
+        {
+            std::lock_guard< std::mutex > lock(m_mutex);
+            m_signals += SIGHUP;
+            m_signals += SIGINT;
+            m_signals += SIGTERM;
+            share_wake();
+        }
+
+        open_backend();
+
+        m_finished = false;
+        m_running = true;
+        return true;
+    }
+
+    inline bool block_signals(const sigset &signals,
+                              const std::chrono::nanoseconds &timeout_nsec =
+                                  std::chrono::nanoseconds(0))
+    {
+        m_timeout_nsec = timeout_nsec;
+
+        this_thread::fill_mask();
+
+        {
+            std::lock_guard< std::mutex > lock(m_mutex);
+            m_signals = signals;
+            m_signals |= m_handlers.signals();
+            share_wake();
+        }
+
+        open_backend();
+
+        m_finished = false;
+        m_running = true;
+        return true;
+    }
+
+    // A signal outside the loop's set is added to it, also after
+    // block_signals() and while the loop runs: a signalfd watches it at
+    // once, and a sigwait loop is woken to wait on it too.  Like the rest
+    // of the set, it must be blocked in every thread.
+    inline bool set_handler(const signum_t signum,
+                            const handler_table::handler_type &handler)
+    {
+        if (!m_handlers.set(signum, handler))
+        {
+            return false;
+        }
+
+        add_signal(signum);
+        return true;
+    }
+
+    // The signal stays in the loop's set; later deliveries are consumed
+    // without stopping the loop.
+    inline void clear_handler(const signum_t signum)
+    {
+        m_handlers.erase(signum);
+    }
+
+    // Swaps in a whole new set of handlers; safe while the loop runs.
+    inline void replace_handlers(const handler_table &handlers)
+    {
+        m_handlers.replace(handlers);
+    }
+
+    inline handler_table handlers() const { return m_handlers.snapshot(); }
+
+    inline int exec(const std::function< bool(int)> &signalHandler,
+                    const std::function< int() > &exitHandler)
+    {
+        return exec_internal(signalHandler, exitHandler);
+    }
+
+    inline int exec(const std::function< bool(int)> &signalHandler)
+    {
+        return exec(signalHandler, &signal_loop::default_exit_handler);
+    }
+
+    inline int exec(const std::function< int() > &exitHandler)
+    {
+        return exec(registered_handler(), exitHandler);
+    }
+
+    inline int exec()
+    {
+        return exec(registered_handler(), &signal_loop::default_exit_handler);
+    }
+
+    template < typename... Handlers >
+    inline int exec(static_dispatcher< Handlers... > dispatcher,
+                    const std::function< int() > &exitHandler)
+    {
+        return exec_internal(dispatcher, exitHandler);
+    }
+
+    template < typename... Handlers >
+    inline int exec(static_dispatcher< Handlers... > dispatcher)
+    {
+        return exec(dispatcher, &signal_loop::default_exit_handler);
+    }
+
+    inline void exec_async(const std::function< bool(int)> &signalHandler,
+                           const std::function< int() > &exitHandler)
+    {
+        exec_async_internal(signalHandler, exitHandler);
+    }
+
+    inline void exec_async(const std::function< bool(int)> &signalHandler)
+    {
+        exec_async(signalHandler, &signal_loop::default_exit_handler);
+    }
+
+    inline void exec_async(const std::function< int() > &exitHandler)
+    {
+        exec_async(registered_handler(), exitHandler);
+    }
+
+    inline void exec_async()
+    {
+        exec_async(registered_handler(), &signal_loop::default_exit_handler);
+    }
+
+    template < typename... Handlers >
+    inline void exec_async(const static_dispatcher< Handlers... > &dispatcher,
+                           const std::function< int() > &exitHandler)
+    {
+        exec_async_internal(dispatcher, exitHandler);
+    }
+
+    template < typename... Handlers >
+    inline void exec_async(const static_dispatcher< Handlers... > &dispatcher)
+    {
+        exec_async(dispatcher, &signal_loop::default_exit_handler);
+    }
+
+    inline void set_batch_size(const std::size_t count)
+    {
+        m_batch_size = (count > 0) ? count : 1;
+    }
+
+    inline int exec_batch(const batch_handler_type &signalHandler,
+                          const std::function< int() > &exitHandler)
+    {
+        return exec_batch_internal(signalHandler, exitHandler);
+    }
+
+    inline int exec_batch(const batch_handler_type &signalHandler)
+    {
+        return exec_batch(signalHandler, &signal_loop::default_exit_handler);
+    }
+
+    inline void exec_batch_async(const batch_handler_type &signalHandler,
+                                 const std::function< int() > &exitHandler)
+    {
+        start_thread(std::bind(&signal_loop::exec_batch_internal_noret,
+                               this,
+                               signalHandler,
+                               exitHandler));
+    }
+
+    inline void exec_batch_async(const batch_handler_type &signalHandler)
+    {
+        exec_batch_async(signalHandler, &signal_loop::default_exit_handler);
+    }
+
+    // An eventfd that is signalled whenever a handler has run and once the
+    // exit handler has completed.  Call before exec_async().
+    inline int notify_fd()
+    {
+        m_notify.open();
+        return m_notify.native_handle();
+    }
+
+    inline bool finished() const { return m_finished; }
+
+    inline stats_snapshot stats() const { return m_stats.snapshot(); }
+
+    inline void set_timestamped(const sigset &signals)
+    {
+        m_stats.set_timestamped(signals);
+    }
+
+    inline void wait_for_exec_async()
+    {
+        if (m_thread && m_thread->joinable())
+        {
+            m_thread->join();
+        }
+    }
+
+    // Ends the loop without waiting for it.  A loop blocked in a wait is
+    // woken by tgkill() of the reserved wake signal to the loop thread
+    // alone; nothing outside this process is signalled.  Only when no
+    // realtime signal could be reserved is sig (or another signal of the
+    // loop's set) used instead.  Either way the wake-up is not dispatched.
+    // If the application waits on the wake signal itself, its deliveries
+    // are still dispatched; only a tgkill() from within this process then
+    // counts as a wake-up.
+    inline void request_stop(int sig = SIGINT)
+    {
+        m_running = false;
+
+        const ::pid_t tid = m_tid;
+        if (tid == 0)
+        {
+            return;
+        }
+
+        if (m_wake > 0)
+        {
+            sig = m_wake;
+        }
+        else
+        {
+            std::lock_guard< std::mutex > lock(m_mutex);
+            if (m_signals.empty())
+            {
+                return;
+            }
+            else if (!m_signals.has(sig))
+            {
+                sig = *m_signals.begin();
+            }
+        }
+        ::syscall(SYS_tgkill, ::getpid(), tid, sig);
+    }
+
+    inline void stop(int sig = SIGINT)
+    {
+        request_stop(sig);
+        wait_for_exec_async();
+    }
+
+    inline int exit_code() const { return m_exit_code; }
+
+    // Runs the registered handler for a signal received outside the loop,
+    // e.g. through io_uring, and records it in stats().  Must not be called
+    // while the loop itself runs.
+    inline bool dispatch(const ::siginfo_t &info)
+    {
+        if (is_wakeup(info))
+        {
+            return true;
+        }
+
+        m_handlers.quiesce();
+        return dispatch_internal(m_handlers, info);
+    }
+
+   private:
+    static inline int default_exit_handler() { return 0; }
+
+    inline std::function< bool(int) > registered_handler()
+    {
+        return [this](int sig) { return m_handlers(sig); };
+    }
+
+    inline sigset wait_signals() const
+    {
+        sigset signals = m_signals;
+        if (m_wake > 0)
+        {
+            signals += m_wake;
+        }
+        return signals;
+    }
+
+    inline void add_signal(const signum_t signum)
+    {
+        ::pid_t tid = 0;
+        {
+            std::lock_guard< std::mutex > lock(m_mutex);
+            if (m_signals.has(signum))
+            {
+                return;
+            }
+
+            m_signals += signum;
+            share_wake();
+            if (m_backend == backend::signalfd && m_fd.is_open())
+            {
+                this_process::set_action(sigset(signum));
+                m_fd.open(wait_signals());
+                return;
+            }
+
+            m_changed = true;
+            tid = m_tid;
+        }
+
+        // without a wake signal the set is refreshed after the next delivery
+        if (tid != 0 && m_wake > 0)
+        {
+            ::syscall(SYS_tgkill, ::getpid(), tid, m_wake);
+        }
+    }
+
+    // Called with m_mutex held whenever m_signals changes.
+    inline void share_wake()
+    {
+        m_wake_shared = (m_wake > 0 && m_signals.has(m_wake));
+    }
+
+    inline bool is_wakeup(const ::siginfo_t &info) const
+    {
+        if (info.si_signo != m_wake)
+        {
+            return false;
+        }
+
+        if (!m_wake_shared.load(std::memory_order_relaxed))
+        {
+            return true;
+        }
+
+        return (info.si_code == SI_TKILL && info.si_pid == ::getpid());
+    }
+
+    inline void open_backend()
+    {
+        if (m_backend == backend::signalfd)
+        {
+            sigset signals;
+            {
+                std::lock_guard< std::mutex > lock(m_mutex);
+                signals = wait_signals();
+            }
+            this_process::set_action(signals);
+            m_fd.open(signals);
+        }
+        else
+        {
+            m_fd.close();
+        }
+    }
+
+    inline void start_thread(const std::function< void() > &fn)
+    {
+        m_thread_error = 0;
+        m_thread.reset(new impl::thread(fn, m_thread_options.stack_size));
+        if (m_thread->error() != 0)
+            m_thread_error = m_thread->error();
+    }
+
+    // Publishes the loop thread and takes the set it waits on under the
+    // same lock, so set_handler() either adds to the set first or not at all.
+    inline void start_internal()
+    {
+        m_thread_error = m_thread_options.apply();
+
+        std::lock_guard< std::mutex > lock(m_mutex);
+        m_tid = static_cast< ::pid_t >(::syscall(SYS_gettid));
+        m_waiting = wait_signals();
+        m_changed = false;
+    }
+
+    // Takes up signals that set_handler() added while the loop runs.
+    inline void refresh_internal()
+    {
+        if (m_changed.load(std::memory_order_relaxed) && m_changed.exchange(false))
+        {
+            std::lock_guard< std::mutex > lock(m_mutex);
+            m_waiting = wait_signals();
+        }
+    }
+
+    inline int finish_internal(const std::function< int() > &exitHandler)
+    {
+        m_handlers.quiesce();
+        {
+            std::lock_guard< std::mutex > lock(m_mutex);
+            m_tid = 0;
+        }
+        m_exit_code = exitHandler();
+        m_finished = true;
+        m_notify.notify();
+        return m_exit_code;
+    }
+
+    inline signum_t wait_internal(::siginfo_t *info)
+    {
+        if (m_backend == backend::signalfd && m_fd.is_open())
+        {
+            if (m_timeout_nsec > std::chrono::nanoseconds(0))
+            {
+                return wait(m_fd, m_timeout_nsec, info);
+            }
+
+            return wait(m_fd, info);
+        }
+
+        if (m_timeout_nsec > std::chrono::nanoseconds(0))
+        {
+            return wait(m_waiting, m_timeout_nsec, info);
+        }
+
+        return wait(m_waiting, info);
+    }
+
+    inline ::ssize_t wait_batch_internal(::siginfo_t *infos,
+                                         const std::size_t count)
+    {
+        if (m_backend == backend::signalfd && m_fd.is_open())
+        {
+            if (m_timeout_nsec > std::chrono::nanoseconds(0))
+            {
+                return wait_batch(m_fd, m_timeout_nsec, infos, count);
+            }
+
+            return wait_batch(m_fd, infos, count);
+        }
+
+        if (m_timeout_nsec > std::chrono::nanoseconds(0))
+        {
+            return wait_batch(m_waiting, m_timeout_nsec, infos, count);
+        }
+
+        return wait_batch(m_waiting, infos, count);
+    }
+
+    template < typename SignalHandler >
+    inline int exec_internal(SignalHandler &signalHandler,
+                             const std::function< int() > &exitHandler)
+    {
+        start_internal();
+
+        while (m_running)
+        {
+            m_handlers.quiesce();
+            refresh_internal();
+
+            ::siginfo_t info;
+            const signum_t signum = wait_internal(&info);
+
+            if (signum > 0 && !is_wakeup(info) && m_running)
+            {
+                if (!dispatch_internal(signalHandler, info))
+                {
+                    m_running = false;
+                }
+            }
+        }
+
+        return finish_internal(exitHandler);
+    }
+
+    template < typename SignalHandler >
+    inline bool dispatch_internal(SignalHandler &signalHandler,
+                                  const ::siginfo_t &info)
+    {
+        const signal_statistics::clock_type::time_point start =
+            signal_statistics::clock_type::now();
+        const bool keep_running = signalHandler(info.si_signo);
+        m_stats.record(info, start, signal_statistics::clock_type::now());
+        m_notify.notify();
+        return keep_running;
+    }
+
+    template < typename SignalHandler >
+    inline void exec_internal_noret(SignalHandler &signalHandler,
+                                    const std::function< int() > &exitHandler)
+    {
+        exec_internal(signalHandler, exitHandler);
+    }
+
+    template < typename SignalHandler >
+    inline void exec_async_internal(const SignalHandler &signalHandler,
+                                    const std::function< int() > &exitHandler)
+    {
+        start_thread(
+            std::bind(&signal_loop::exec_internal_noret< SignalHandler >,
+                      this,
+                      signalHandler,
+                      exitHandler));
+    }
+
+    inline int exec_batch_internal(const batch_handler_type &signalHandler,
+                                   const std::function< int() > &exitHandler)
+    {
+        std::vector< ::siginfo_t > infos(m_batch_size);
+
+        start_internal();
+
+        while (m_running)
+        {
+            m_handlers.quiesce();
+            refresh_internal();
+
+            const ::ssize_t count = discard_wakeups(
+                infos.data(), wait_batch_internal(infos.data(), infos.size()));
+
+            if (count > 0 && m_running)
+            {
+                const signal_statistics::clock_type::time_point start =
+                    signal_statistics::clock_type::now();
+                const bool keep_running =
+                    signalHandler(siginfo_span(infos.data(), count));
+                const signal_statistics::clock_type::time_point finish =
+                    signal_statistics::clock_type::now();
+
+                // the batch's handler time is shared evenly by its signals
+                const signal_statistics::clock_type::duration share =
+                    (finish - start) / count;
+                for (::ssize_t i = 0; i < count; ++i)
+                    m_stats.record(infos[i], start, start + share);
+                m_notify.notify();
+
+                if (!keep_running)
+                {
+                    m_running = false;
+                }
+            }
+        }
+
+        return finish_internal(exitHandler);
+    }
+
+    inline ::ssize_t discard_wakeups(::siginfo_t *infos, const ::ssize_t count)
+    {
+        ::ssize_t kept = 0;
+        for (::ssize_t i = 0; i < count; ++i)
+        {
+            if (!is_wakeup(infos[i]))
+            {
+                infos[kept++] = infos[i];
+            }
+        }
+        return (count > 0) ? kept : count;
+    }
+
+    inline void exec_batch_internal_noret(
+        const batch_handler_type &signalHandler,
+        const std::function< int() > &exitHandler)
+    {
+        exec_batch_internal(signalHandler, exitHandler);
+    }
+
+   private:
+    mutable std::mutex m_mutex;
+    sigset m_signals;
+    sigset m_waiting;
+    shared_handler_table m_handlers;
+    signal_statistics m_stats;
+    std::atomic< bool > m_running;
+    std::atomic< bool > m_finished;
+    std::atomic< ::pid_t > m_tid;
+    std::atomic< bool > m_changed;
+    signum_t m_wake;
+    std::atomic< bool > m_wake_shared;
+    event_fd m_notify;
+    backend m_backend;
+    signal_fd m_fd;
+    std::size_t m_batch_size;
+    std::chrono::nanoseconds m_timeout_nsec;
+    thread_options m_thread_options;
+    std::unique_ptr< impl::thread > m_thread;
+    std::atomic< int > m_thread_error;
+    int m_exit_code;
+};
+
+class signal_manager
+{
+   public:
+    typedef signal_loop::backend backend;
+    typedef signal_loop::batch_handler_type batch_handler_type;
+
+    // The process-wide loop behind the static interface.
+    static inline signal_loop &loop() { return instance(); }
+
+    static inline void set_backend(const backend type)
+    {
+        instance().set_backend(type);
+    }
+
+    static inline int fd() { return instance().fd(); }
+
+    static inline void set_thread_options(const thread_options &options)
+    {
+        instance().set_thread_options(options);
+    }
+
+    static inline int thread_error() { return instance().thread_error(); }
+
+    static inline bool block_signals(
+        const std::chrono::nanoseconds &timeout_nsec =
+            std::chrono::nanoseconds(0))
+    {
+        return instance().block_signals(timeout_nsec);
+    }
+
+    static inline bool block_signals(
+        const sigset &signals,
+        const std::chrono::nanoseconds &timeout_nsec =
+            std::chrono::nanoseconds(0))
+    {
+        return instance().block_signals(signals, timeout_nsec);
+    }
+
+    static inline int exec(const std::function< bool(int)> &signalHandler,
+                           const std::function< int() > &exitHandler)
+    {
+        return instance().exec(signalHandler, exitHandler);
+    }
+
+    static inline int exec(const std::function< bool(int)> &signalHandler)
+    {
+        return instance().exec(signalHandler);
+    }
+
+    static inline int exec(const std::function< int() > &exitHandler)
+    {
+        return instance().exec(exitHandler);
+    }
+
+    static inline int exec() { return instance().exec(); }
+    
+    static inline void exec_async(const std::function< bool(int)> &signalHandler,
+                           const std::function< int() > &exitHandler)
+    {
+        instance().exec_async(signalHandler, exitHandler);
+    }
+
+    static inline void exec_async(const std::function< bool(int)> &signalHandler)
+    {
+        instance().exec_async(signalHandler);
+    }
+
+    static inline void exec_async(const std::function< int() > &exitHandler)
+    {
+        instance().exec_async(exitHandler);
+    }
+
+    static inline void exec_async() { instance().exec_async(); }
+    
+    static inline void set_batch_size(const std::size_t count)
+    {
+        instance().set_batch_size(count);
+    }
+
+    static inline int exec_batch(const batch_handler_type &signalHandler,
+                                 const std::function< int() > &exitHandler)
+    {
+        return instance().exec_batch(signalHandler, exitHandler);
+    }
+
+    static inline int exec_batch(const batch_handler_type &signalHandler)
+    {
+        return instance().exec_batch(signalHandler);
+    }
+
+    static inline void exec_batch_async(
+        const batch_handler_type &signalHandler,
+        const std::function< int() > &exitHandler)
+    {
+        instance().exec_batch_async(signalHandler, exitHandler);
+    }
+
+    static inline void exec_batch_async(const batch_handler_type &signalHandler)
+    {
+        instance().exec_batch_async(signalHandler);
+    }
+
+    static inline bool set_handler(const signum_t signum,
+                                   const handler_table::handler_type &handler)
+    {
+        return instance().set_handler(signum, handler);
+    }
+
+    static inline void clear_handler(const signum_t signum)
+    {
+        instance().clear_handler(signum);
+    }
+
+    static inline void replace_handlers(const handler_table &handlers)
+    {
+        instance().replace_handlers(handlers);
+    }
+
+    static inline handler_table handlers() { return instance().handlers(); }
+
+    template < typename... Handlers >
+    static inline int exec(static_dispatcher< Handlers... > dispatcher,
+                           const std::function< int() > &exitHandler)
+    {
+        return instance().exec(dispatcher, exitHandler);
+    }
+
+    template < typename... Handlers >
+    static inline int exec(static_dispatcher< Handlers... > dispatcher)
+    {
+        return instance().exec(dispatcher);
+    }
+
+    template < typename... Handlers >
+    static inline void exec_async(
+        const static_dispatcher< Handlers... > &dispatcher,
+        const std::function< int() > &exitHandler)
+    {
+        instance().exec_async(dispatcher, exitHandler);
+    }
+
+    template < typename... Handlers >
+    static inline void exec_async(
+        const static_dispatcher< Handlers... > &dispatcher)
+    {
+        instance().exec_async(dispatcher);
+    }
+
+    // An eventfd that is signalled whenever a handler has run and once the
+    // exit handler has completed.  Call before exec_async().
+    static inline int notify_fd() { return instance().notify_fd(); }
+
+    static inline bool finished() { return instance().finished(); }
+
+    static inline stats_snapshot stats() { return instance().stats(); }
+
+    static inline void set_timestamped(const sigset &signals)
+    {
+        instance().set_timestamped(signals);
+    }
+
+    static inline void wait_for_exec_async()
+    {
+        instance().wait_for_exec_async();
+    }
+
+    static inline void kill(int sig = SIGINT) { ::kill(0, sig); }
+
+    static inline void stop(int sig = SIGINT) { instance().stop(sig); }
+    
+    static inline int exit_code() { return instance().exit_code(); }
+
+   private:
+    static inline signal_loop &instance()
+    {
+        static signal_loop loop;
+        return loop;
+    }
+
+    signal_manager() = delete;
 };
 
 }  // namespace psig
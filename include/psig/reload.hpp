@@ -0,0 +1,280 @@
+/* Copyright (c) 2015, Chris Knight, Daniel C. Dillon
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <psig/psig.hpp>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace psig
+{
+// A value, typically configuration, that readers use on hot paths while a
+// reload replaces it, e.g. from the signal manager thread on SIGHUP.
+//
+// Readers announce themselves in a counter slot chosen by thread and read the
+// current pointer: two atomic operations, no locks and no retries.  A reload
+// builds the new value off the hot path, publishes it with one atomic pointer
+// exchange and retires the old value.  A retired value is freed once every
+// reader that could still see it has finished (two grace periods, as in
+// userspace RCU).  Grace periods only advance when readers have already left,
+// so neither publish() nor collect() ever waits for them.
+template < typename T >
+class reloadable
+{
+   public:
+    typedef T value_type;
+    typedef std::function< std::unique_ptr< T >() > loader_type;
+
+    // Keeps the value it was read from alive until destroyed; hold it only
+    // for the duration of one request.
+    class snapshot
+    {
+       public:
+        snapshot(snapshot &&that) noexcept
+            : m_value(that.m_value)
+            , m_count(that.m_count)
+        {
+            that.m_count = nullptr;
+        }
+
+        ~snapshot()
+        {
+            if (m_count != nullptr)
+                m_count->fetch_sub(1, std::memory_order_release);
+        }
+
+        snapshot(const snapshot &) = delete;
+        snapshot &operator=(const snapshot &) = delete;
+        snapshot &operator=(snapshot &&) = delete;
+
+        const T *get() const noexcept { return m_value; }
+        const T &operator*() const noexcept { return *m_value; }
+        const T *operator->() const noexcept { return m_value; }
+
+       private:
+        friend class reloadable;
+
+        snapshot(const T *value, std::atomic< std::uint32_t > *count) noexcept
+            : m_value(value)
+            , m_count(count)
+        {
+        }
+
+        const T *m_value;
+        std::atomic< std::uint32_t > *m_count;
+    };
+
+    explicit reloadable(std::unique_ptr< T > initial,
+                        const loader_type &loader = loader_type(),
+                        const std::size_t slots = 64)
+        : m_current(initial.release())
+        , m_loader(loader)
+        , m_phase(0)
+        , m_flipped(false)
+        , m_grace(0)
+        , m_version(1)
+        , m_slots(new slot[slots > 0 ? slots : 1])
+        , m_capacity(slots > 0 ? slots : 1)
+    {
+        for (std::size_t i = 0; i < m_capacity; ++i)
+        {
+            m_slots[i].counts[0].store(0, std::memory_order_relaxed);
+            m_slots[i].counts[1].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    ~reloadable()
+    {
+        for (const retired_value &r : m_retired)
+            delete r.value;
+        delete m_current.load(std::memory_order_relaxed);
+    }
+
+    reloadable(const reloadable &) = delete;
+    reloadable &operator=(const reloadable &) = delete;
+
+    snapshot read() const noexcept
+    {
+        slot &s = m_slots[impl::thread_index() % m_capacity];
+        const unsigned phase = m_phase.load(std::memory_order_seq_cst);
+        s.counts[phase].fetch_add(1, std::memory_order_seq_cst);
+        return snapshot(m_current.load(std::memory_order_seq_cst),
+                        &s.counts[phase]);
+    }
+
+    // Incremented by every publish().
+    std::uint64_t version() const noexcept
+    {
+        return m_version.load(std::memory_order_acquire);
+    }
+
+    // Replaces the value and retires the previous one.  Never blocks on
+    // readers: retired values are freed by this or a later publish() or
+    // collect(), once no reader can still hold them.
+    void publish(std::unique_ptr< T > value)
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+
+        T *old = m_current.exchange(value.release(), std::memory_order_seq_cst);
+        m_version.fetch_add(1, std::memory_order_release);
+
+        // two grace periods that start after the exchange; one already in
+        // progress does not count
+        retired_value r;
+        r.value = old;
+        r.grace = m_grace + (m_flipped ? 1 : 0) + 2;
+        m_retired.push_back(r);
+
+        collect_locked();
+    }
+
+    // Frees the retired values that no reader can hold any more, without
+    // waiting.  Returns the number still retired; call again later, e.g.
+    // from a timer, while it is not 0.
+    std::size_t collect()
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        return collect_locked();
+    }
+
+    std::size_t retired() const
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        return m_retired.size();
+    }
+
+    // Builds a new value with the loader and publishes it.  Returns false,
+    // keeping the current value, when the loader fails.
+    bool reload()
+    {
+        if (!m_loader)
+            return false;
+
+        std::unique_ptr< T > value = m_loader();
+        if (!value)
+            return false;
+
+        publish(std::move(value));
+        return true;
+    }
+
+    // Reloads on every signum handled by loop.
+    bool attach(signal_loop &loop, const signum_t signum = SIGHUP)
+    {
+        return loop.set_handler(signum, [this](int) {
+            reload();
+            return true;
+        });
+    }
+
+    bool attach(const signum_t signum = SIGHUP)
+    {
+        return attach(signal_manager::loop(), signum);
+    }
+
+   private:
+    // padded to a cache line so that readers on different slots do not
+    // share one
+    struct slot
+    {
+        std::atomic< std::uint32_t > counts[2];
+        char padding[64 - 2 * sizeof(std::atomic< std::uint32_t >)];
+    };
+
+    struct retired_value
+    {
+        T *value;
+        std::uint64_t grace;
+    };
+
+    bool drained(const unsigned phase) const
+    {
+        for (std::size_t i = 0; i < m_capacity; ++i)
+            if (m_slots[i].counts[phase].load(std::memory_order_seq_cst) != 0)
+                return false;
+        return true;
+    }
+
+    // Readers that entered before an exchange counted themselves in the
+    // phase they read.  A grace period flips the phase and ends once the old
+    // phase has drained; two of them cover readers that raced with a flip.
+    // Periods only advance while values wait for them.
+    std::size_t collect_locked()
+    {
+        while (!m_retired.empty())
+        {
+            if (m_flipped)
+            {
+                if (!drained(m_phase.load(std::memory_order_relaxed) ^ 1))
+                    break;
+
+                m_flipped = false;
+                ++m_grace;
+                continue;
+            }
+
+            if (m_retired.back().grace <= m_grace)
+                break;
+
+            const unsigned phase = m_phase.load(std::memory_order_relaxed);
+            m_phase.store(phase ^ 1, std::memory_order_seq_cst);
+            m_flipped = true;
+        }
+
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < m_retired.size(); ++i)
+        {
+            if (m_retired[i].grace <= m_grace)
+                delete m_retired[i].value;
+            else
+                m_retired[kept++] = m_retired[i];
+        }
+        m_retired.resize(kept);
+        return kept;
+    }
+
+   private:
+    std::atomic< T * > m_current;
+    loader_type m_loader;
+    mutable std::mutex m_mutex;
+    std::atomic< unsigned > m_phase;
+    bool m_flipped;
+    std::uint64_t m_grace;
+    std::vector< retired_value > m_retired;
+    std::atomic< std::uint64_t > m_version;
+    std::unique_ptr< slot[] > m_slots;
+    std::size_t m_capacity;
+};
+}  // namespace psig
@@ -0,0 +1,190 @@
+/* Copyright (c) 2015, Chris Knight, Daniel C. Dillon
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <psig/psig.hpp>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace psig
+{
+// Spreads signals over several signal_loop shards, each with its own thread,
+// so that a slow handler on one shard (a SIGHUP reload, say) does not hold up
+// signals routed to another.  Every shard waits only on its own signals;
+// process-directed signals are picked up by whichever shard waits on them.
+class signal_router
+{
+   public:
+    static const std::size_t npos = ~std::size_t(0);
+
+    explicit signal_router(const std::size_t shards,
+                           const signal_loop::backend type =
+                               signal_loop::backend::sigwait)
+        : m_stopped(false)
+    {
+        m_routes.fill(std::size_t(npos));
+
+        for (std::size_t i = 0; i < shards; ++i)
+        {
+            m_shards.emplace_back(new signal_loop());
+            m_shards.back()->set_backend(type);
+        }
+    }
+
+    ~signal_router() { stop(); }
+
+    signal_router(const signal_router &) = delete;
+    signal_router &operator=(const signal_router &) = delete;
+
+    std::size_t size() const { return m_shards.size(); }
+
+    signal_loop &shard(const std::size_t index) { return *m_shards[index]; }
+
+    // Assigns a signal and its handler to a shard, moving it off any shard it
+    // was routed to before.  Call before block_signals().
+    bool route(const signum_t signum,
+               const std::size_t index,
+               const handler_table::handler_type &handler)
+    {
+        if (signum <= 0 || signum >= _NSIG || index >= m_shards.size())
+        {
+            return false;
+        }
+
+        const std::size_t previous = m_routes[signum];
+        if (previous != npos && previous != index)
+        {
+            m_shards[previous]->clear_handler(signum);
+        }
+
+        if (!m_shards[index]->set_handler(signum, handler))
+        {
+            return false;
+        }
+
+        m_routes[signum] = index;
+        return true;
+    }
+
+    std::size_t shard_of(const signum_t signum) const
+    {
+        if (signum <= 0 || signum >= _NSIG)
+        {
+            return npos;
+        }
+
+        return m_routes[signum];
+    }
+
+    // Blocks all signals in the calling thread and gives every shard exactly
+    // the signals routed to it.  Call from the main thread before starting
+    // any other threads.
+    bool block_signals(const std::chrono::nanoseconds &timeout_nsec =
+                           std::chrono::nanoseconds(0))
+    {
+        std::vector< sigset > sets(m_shards.size());
+        for (int signum = 1; signum < _NSIG; ++signum)
+        {
+            if (m_routes[signum] != npos)
+            {
+                sets[m_routes[signum]] += signum;
+            }
+        }
+
+        for (std::size_t i = 0; i < m_shards.size(); ++i)
+        {
+            if (!m_shards[i]->block_signals(sets[i], timeout_nsec))
+            {
+                return false;
+            }
+        }
+
+        m_stopped = false;
+        return true;
+    }
+
+    // Starts every shard on its own thread.  When any shard's handler ends
+    // its loop the others are asked to stop as well.
+    void exec_async()
+    {
+        for (std::size_t i = 0; i < m_shards.size(); ++i)
+        {
+            m_shards[i]->exec_async(
+                [this, i]() { return on_shard_exit(i); });
+        }
+    }
+
+    void wait()
+    {
+        for (std::size_t i = 0; i < m_shards.size(); ++i)
+        {
+            m_shards[i]->wait_for_exec_async();
+        }
+    }
+
+    void stop(const int sig = SIGINT)
+    {
+        for (std::size_t i = 0; i < m_shards.size(); ++i)
+        {
+            m_shards[i]->request_stop(sig);
+        }
+
+        wait();
+    }
+
+   private:
+    int on_shard_exit(const std::size_t index)
+    {
+        bool expected = false;
+        if (!m_stopped.compare_exchange_strong(expected, true))
+        {
+            return 0;
+        }
+
+        for (std::size_t i = 0; i < m_shards.size(); ++i)
+        {
+            if (i != index)
+            {
+                m_shards[i]->request_stop();
+            }
+        }
+
+        return 0;
+    }
+
+   private:
+    std::vector< std::unique_ptr< signal_loop > > m_shards;
+    std::array< std::size_t, _NSIG > m_routes;
+    std::atomic< bool > m_stopped;
+};
+}  // namespace psig
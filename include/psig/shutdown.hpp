@@ -0,0 +1,335 @@
+/* Copyright (c) 2015, Chris Knight, Daniel C. Dillon
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <psig/psig.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <unistd.h>
+
+namespace psig
+{
+// Stops an application's components in stages when the signal manager
+// exits.  Components register with a stage and a deadline.  Stages run in
+// ascending order, each after the previous one has finished, and the
+// components of one stage stop in parallel, each on its own thread.  A
+// second shutdown signal, or a component that misses its deadline,
+// escalates to a forced exit.
+//
+//     shutdown.add(0, "listener", [&]() { listener.close(); });
+//     shutdown.add(1, "pool", [&]() { pool.drain(); }, seconds(5));
+//     shutdown.attach();
+//     return signal_manager::exec(shutdown.exit_handler());
+class shutdown_orchestrator
+{
+   public:
+    typedef std::function< void() > stop_type;
+    typedef std::function< int() > force_handler_type;
+
+    // The force handler runs on escalation and its result becomes the exit
+    // code; without one, the process calls _exit(forced_code).  Components
+    // that missed their deadline are still running user code on detached
+    // threads, so a force handler must not return into normal process
+    // teardown: static destructors and exit() would pull objects out from
+    // under them.  It should end the process itself, e.g. with _exit() or
+    // quick_exit() after logging pending(), or hand its code to a caller
+    // that does.
+    explicit shutdown_orchestrator(
+        const int forced_code = EXIT_FAILURE,
+        const force_handler_type &force = force_handler_type())
+        : m_forced_code(forced_code)
+        , m_force(force)
+        , m_signals{SIGTERM, SIGINT}
+        , m_started(false)
+        , m_forced(false)
+    {
+    }
+
+    shutdown_orchestrator(const shutdown_orchestrator &) = delete;
+    shutdown_orchestrator &operator=(const shutdown_orchestrator &) = delete;
+
+    // Registers a component.  Its stop function must return once the
+    // component has stopped.  The deadline counts from the start of the
+    // component's stage.
+    void add(const std::size_t stage,
+             const std::string &name,
+             const stop_type &stop,
+             const std::chrono::nanoseconds deadline = std::chrono::seconds(30))
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+
+        component c;
+        c.stage = stage;
+        c.name = name;
+        c.stop = stop;
+        c.deadline = deadline;
+        m_components.push_back(c);
+    }
+
+    std::size_t size() const
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        return m_components.size();
+    }
+
+    // Makes the first of signals end loop, and a second one escalate.
+    bool attach(signal_loop &loop, const sigset &signals = sigset{SIGTERM, SIGINT})
+    {
+        {
+            std::lock_guard< std::mutex > lock(m_mutex);
+            m_signals = signals;
+        }
+
+        for (const signum_t signum : signals)
+            if (!loop.set_handler(signum, [](int) { return false; }))
+                return false;
+        return true;
+    }
+
+    bool attach(const sigset &signals = sigset{SIGTERM, SIGINT})
+    {
+        return attach(signal_manager::loop(), signals);
+    }
+
+    // An exit handler for exec() and exec_async() that runs the shutdown.
+    std::function< int() > exit_handler()
+    {
+        return [this]() { return run(); };
+    }
+
+    // Whether the last shutdown was forced.
+    bool forced() const noexcept { return m_forced; }
+
+    // The components that had not stopped when the shutdown was forced.
+    std::vector< std::string > pending() const
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        return m_pending;
+    }
+
+    // Stops every stage in order.  Returns 0, or the force handler's
+    // result if the shutdown was forced; stop threads may still be running
+    // then, see the constructor.  Runs only once.
+    int run()
+    {
+        if (m_started.exchange(true))
+            return 0;
+
+        std::vector< component > components;
+        sigset signals;
+        {
+            std::lock_guard< std::mutex > lock(m_mutex);
+            components = m_components;
+            signals = m_signals;
+        }
+
+        std::stable_sort(components.begin(),
+                         components.end(),
+                         [](const component &a, const component &b) {
+                             return a.stage < b.stage;
+                         });
+
+        // later shutdown signals stay blocked here and are read from a
+        // signalfd while the stages run
+        const sigset oldsigset = this_thread::add_mask(signals);
+        signal_fd escalation(signals, SFD_CLOEXEC | SFD_NONBLOCK);
+
+        bool clean = true;
+        for (std::size_t first = 0; first < components.size() && clean;)
+        {
+            std::size_t last = first;
+            while (last < components.size() &&
+                   components[last].stage == components[first].stage)
+                ++last;
+
+            clean = run_stage(components, first, last, escalation);
+            first = last;
+        }
+
+        this_thread::set_mask(oldsigset);
+
+        if (clean)
+            return 0;
+
+        m_forced = true;
+        if (m_force)
+            return m_force();
+        ::_exit(m_forced_code);
+    }
+
+   private:
+    struct component
+    {
+        std::size_t stage;
+        std::string name;
+        stop_type stop;
+        std::chrono::nanoseconds deadline;
+    };
+
+    // Shared with the stop threads, which may outlive a forced stage.
+    struct stage_state
+    {
+        explicit stage_state(const std::size_t count)
+            : done(new std::atomic< bool >[count])
+        {
+            for (std::size_t i = 0; i < count; ++i)
+                done[i].store(false);
+            wakeup.open();
+        }
+
+        std::unique_ptr< std::atomic< bool >[] > done;
+        event_fd wakeup;
+    };
+
+    bool run_stage(const std::vector< component > &components,
+                   const std::size_t first,
+                   const std::size_t last,
+                   signal_fd &escalation)
+    {
+        typedef std::chrono::steady_clock clock_type;
+
+        const std::size_t count = last - first;
+        const clock_type::time_point start = clock_type::now();
+        std::shared_ptr< stage_state > state(new stage_state(count));
+
+        std::vector< std::thread > threads;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const stop_type stop = components[first + i].stop;
+            threads.emplace_back([state, stop, i]() {
+                this_thread::fill_mask();
+                try
+                {
+                    stop();
+                }
+                catch (...)
+                {
+                }
+                state->done[i].store(true);
+                state->wakeup.notify();
+            });
+        }
+
+        bool clean = true;
+        for (;;)
+        {
+            // the earliest deadline among the components still stopping
+            const clock_type::time_point now = clock_type::now();
+            bool finished = true;
+            bool missed = false;
+            std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max();
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                if (state->done[i].load())
+                    continue;
+
+                finished = false;
+                const std::chrono::nanoseconds left =
+                    components[first + i].deadline - (now - start);
+                if (left <= std::chrono::nanoseconds(0))
+                    missed = true;
+                timeout = std::min(timeout, left);
+            }
+
+            if (finished)
+                break;
+
+            if (missed)
+            {
+                clean = false;
+                break;
+            }
+
+            ::pollfd fds[2];
+            fds[0].fd = state->wakeup.native_handle();
+            fds[0].events = POLLIN;
+            fds[1].fd = escalation.native_handle();
+            fds[1].events = POLLIN;
+
+            // round up, so the deadline has passed when poll() times out
+            const int wait_ms =
+                (timeout >= std::chrono::seconds(60))
+                    ? 60000
+                    : static_cast< int >(
+                          std::chrono::duration_cast< std::chrono::milliseconds >(
+                              timeout + std::chrono::milliseconds(1) -
+                              std::chrono::nanoseconds(1))
+                              .count());
+            if (::poll(fds, escalation.is_open() ? 2 : 1, wait_ms) < 0 &&
+                errno != EINTR)
+            {
+                clean = false;
+                break;
+            }
+
+            state->wakeup.consume();
+            if (escalation.is_open() && escalation.read() > 0)
+            {
+                clean = false;
+                break;
+            }
+        }
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (state->done[i].load())
+            {
+                threads[i].join();
+                continue;
+            }
+
+            threads[i].detach();
+            std::lock_guard< std::mutex > lock(m_mutex);
+            m_pending.push_back(components[first + i].name);
+        }
+        return clean;
+    }
+
+   private:
+    int m_forced_code;
+    force_handler_type m_force;
+    mutable std::mutex m_mutex;
+    std::vector< component > m_components;
+    std::vector< std::string > m_pending;
+    sigset m_signals;
+    std::atomic< bool > m_started;
+    std::atomic< bool > m_forced;
+};
+}  // namespace psig
@@ -0,0 +1,95 @@
+/* Copyright (c) 2015, Chris Knight, Daniel C. Dillon
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <ucontext.h>
+
+namespace psig
+{
+namespace impl
+{
+// Drops the frames of a signal handler from a backtrace() taken inside it,
+// so that the stack starts at the interrupted instruction.
+inline std::size_t trim_stack(void **frames, const int depth, void *context)
+{
+    const void *pc = nullptr;
+#if defined(__x86_64__)
+    pc = reinterpret_cast< void * >(
+        static_cast< ::ucontext_t * >(context)->uc_mcontext.gregs[REG_RIP]);
+#elif defined(__aarch64__)
+    pc = reinterpret_cast< void * >(
+        static_cast< ::ucontext_t * >(context)->uc_mcontext.pc);
+#endif
+    int first = 0;
+    for (int i = 0; i < depth; ++i)
+    {
+        if (frames[i] == pc)
+        {
+            first = i;
+            break;
+        }
+    }
+
+    for (int i = first; i < depth; ++i)
+        frames[i - first] = frames[i];
+    return static_cast< std::size_t >(depth - first);
+}
+
+// Return addresses point after the call, so look up the byte before
+// them; the innermost frame is the interrupted instruction itself.
+inline std::string symbol(void *address, const bool innermost)
+{
+    const char *lookup = static_cast< const char * >(address);
+    if (!innermost)
+        --lookup;
+
+    ::Dl_info info;
+    if (::dladdr(lookup, &info) != 0 && info.dli_sname != nullptr)
+    {
+        int status = 0;
+        char *demangled =
+            abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        std::string name(status == 0 ? demangled : info.dli_sname);
+        std::free(demangled);
+        return name;
+    }
+
+    char buffer[2 + 2 * sizeof(void *) + 1];
+    std::snprintf(buffer, sizeof(buffer), "%p", address);
+    return buffer;
+}
+}  // namespace impl
+}  // namespace psig
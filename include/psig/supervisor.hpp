@@ -0,0 +1,281 @@
+/* Copyright (c) 2015, Chris Knight, Daniel C. Dillon
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <psig/psig.hpp>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifndef SYS_pidfd_send_signal
+#define SYS_pidfd_send_signal 424
+#endif
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+namespace psig
+{
+// Tracks child processes through pidfds so that signals reach exactly the
+// registered workers, never a recycled pid or the rest of the process group.
+class supervisor
+{
+   public:
+    // Broadcasts signal batch processes at a time and wait for stagger
+    // between batches; a batch of 0 signals everyone at once.
+    struct fanout
+    {
+        fanout() noexcept : batch(0), stagger(0) {}
+        fanout(const std::size_t b, const std::chrono::nanoseconds s) noexcept
+            : batch(b), stagger(s)
+        {
+        }
+
+        std::size_t batch;
+        std::chrono::nanoseconds stagger;
+    };
+
+    supervisor() = default;
+
+    supervisor(const supervisor &) = delete;
+    supervisor &operator=(const supervisor &) = delete;
+
+    bool add(const ::pid_t pid)
+    {
+        const int fd = static_cast< int >(::syscall(SYS_pidfd_open, pid, 0));
+        if (fd < 0)
+            return false;
+
+        const pidfd_ptr child(new pidfd(fd));
+
+        std::lock_guard< std::mutex > lock(m_mutex);
+        m_children.insert(std::make_pair(pid, child));
+        return true;
+    }
+
+    bool remove(const ::pid_t pid)
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        std::map< ::pid_t, pidfd_ptr >::iterator it = m_children.find(pid);
+        if (it == m_children.end())
+            return false;
+
+        m_children.erase(it);
+        return true;
+    }
+
+    bool contains(const ::pid_t pid) const
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        return (m_children.find(pid) != m_children.end());
+    }
+
+    std::size_t size() const
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        return m_children.size();
+    }
+
+    std::vector< ::pid_t > pids() const
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        std::vector< ::pid_t > result;
+        result.reserve(m_children.size());
+        for (const std::pair< const ::pid_t, pidfd_ptr > &child : m_children)
+            result.push_back(child.first);
+        return result;
+    }
+
+    bool send(const ::pid_t pid, const signum_t signum) const
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        std::map< ::pid_t, pidfd_ptr >::const_iterator it = m_children.find(pid);
+        if (it == m_children.end())
+            return false;
+
+        return send_fd(it->second->fd, signum);
+    }
+
+    // Returns the number of processes signalled.  The children are
+    // snapshotted first, so a staggered broadcast sleeps on the calling
+    // thread without blocking add(), remove(), send() or prune().
+    std::size_t broadcast(const signum_t signum,
+                          const fanout &options = fanout()) const
+    {
+        const std::shared_ptr< pidfds > fds = snapshot();
+
+        std::size_t sent = 0;
+        for (std::size_t first = 0; first < fds->size();)
+        {
+            if (first > 0)
+                std::this_thread::sleep_for(options.stagger);
+            sent += send_batch(*fds, first, signum, options);
+        }
+        return sent;
+    }
+
+    // Forwards signum from the loop to every child.  The first batch is
+    // sent from the loop thread; the staggered rest is sent by a helper
+    // thread, so the loop keeps dispatching meanwhile.
+    bool forward(signal_loop &loop,
+                 const signum_t signum,
+                 const fanout &options = fanout())
+    {
+        return loop.set_handler(signum, [this, options](int sig) {
+            const std::shared_ptr< pidfds > fds = snapshot();
+
+            std::size_t first = 0;
+            send_batch(*fds, first, sig, options);
+            if (first < fds->size())
+            {
+                std::thread([fds, first, sig, options]() mutable {
+                    while (first < fds->size())
+                    {
+                        std::this_thread::sleep_for(options.stagger);
+                        send_batch(*fds, first, sig, options);
+                    }
+                }).detach();
+            }
+            return true;
+        });
+    }
+
+    bool forward(const signum_t signum, const fanout &options = fanout())
+    {
+        return forward(signal_manager::loop(), signum, options);
+    }
+
+    // Drops children that have exited (their pidfd is readable) and returns
+    // their pids.  Reaping them remains the caller's job.
+    std::vector< ::pid_t > prune()
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+
+        std::vector< ::pollfd > pfds;
+        pfds.reserve(m_children.size());
+        for (const std::pair< const ::pid_t, pidfd_ptr > &child : m_children)
+        {
+            ::pollfd pfd;
+            pfd.fd = child.second->fd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            pfds.push_back(pfd);
+        }
+
+        std::vector< ::pid_t > exited;
+        if (pfds.empty() || ::poll(pfds.data(), pfds.size(), 0) <= 0)
+            return exited;
+
+        std::size_t i = 0;
+        for (std::map< ::pid_t, pidfd_ptr >::iterator it = m_children.begin();
+             it != m_children.end();
+             ++i)
+        {
+            if (pfds[i].revents)
+            {
+                exited.push_back(it->first);
+                it = m_children.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        return exited;
+    }
+
+   private:
+    // A child's pidfd, closed once neither the table nor a fanout still in
+    // progress holds it, so remove() and the supervisor's destruction do
+    // not pull it out from under a fanout.
+    struct pidfd
+    {
+        explicit pidfd(const int f) noexcept : fd(f) {}
+        ~pidfd() { ::close(fd); }
+
+        pidfd(const pidfd &) = delete;
+        pidfd &operator=(const pidfd &) = delete;
+
+        const int fd;
+    };
+
+    typedef std::shared_ptr< const pidfd > pidfd_ptr;
+    typedef std::vector< pidfd_ptr > pidfds;
+
+    // Copies only the pointers; no descriptor is duplicated.
+    std::shared_ptr< pidfds > snapshot() const
+    {
+        std::shared_ptr< pidfds > fds(new pidfds);
+
+        std::lock_guard< std::mutex > lock(m_mutex);
+        fds->reserve(m_children.size());
+        for (const std::pair< const ::pid_t, pidfd_ptr > &child : m_children)
+            fds->push_back(child.second);
+        return fds;
+    }
+
+    // Signals the batch starting at first and advances first past it.
+    // Returns the number of processes signalled.
+    static std::size_t send_batch(const pidfds &fds,
+                                  std::size_t &first,
+                                  const signum_t signum,
+                                  const fanout &options)
+    {
+        const std::size_t last =
+            (options.batch > 0 && fds.size() - first > options.batch)
+                ? first + options.batch
+                : fds.size();
+
+        std::size_t sent = 0;
+        for (; first < last; ++first)
+            if (send_fd(fds[first]->fd, signum))
+                ++sent;
+        return sent;
+    }
+
+    static bool send_fd(const int fd, const signum_t signum)
+    {
+        return (::syscall(SYS_pidfd_send_signal, fd, signum, nullptr, 0) == 0);
+    }
+
+   private:
+    mutable std::mutex m_mutex;
+    std::map< ::pid_t, pidfd_ptr > m_children;
+};
+}  // namespace psig
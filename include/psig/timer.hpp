@@ -0,0 +1,383 @@
+/* Copyright (c) 2015, Chris Knight, Daniel C. Dillon
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <psig/psig.hpp>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <time.h>
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+namespace psig
+{
+// Multiplexes any number of one-shot and periodic timers onto one POSIX timer
+// that delivers a single realtime signal.  Timers live in a hierarchical
+// timing wheel and the kernel timer is only ever armed for the next tick that
+// can have work.
+//
+// Callbacks run from expire(), normally on the thread of the loop given to
+// attach().
+class timer_service
+{
+   public:
+    typedef std::chrono::steady_clock clock_type;
+    typedef std::uint64_t timer_id;
+    typedef std::function< void() > callback_type;
+
+    static const std::size_t levels = 4;
+    static const std::size_t slot_bits = 6;
+    static const std::size_t slots = std::size_t(1) << slot_bits;
+
+    // A signum of 0 reserves a free realtime signal for the service's
+    // lifetime; a given signum remains the caller's.  A non-zero tid directs
+    // the timer signal at that thread (SIGEV_THREAD_ID); otherwise it is
+    // process-directed.
+    explicit timer_service(
+        const std::chrono::nanoseconds resolution =
+            std::chrono::milliseconds(1),
+        const signum_t signum = 0,
+        const ::pid_t tid = 0)
+        : m_signum(signum > 0 ? signum : rt::reserve())
+        , m_owned(signum <= 0 && m_signum > 0)
+        , m_resolution(resolution.count() > 0 ? resolution
+                                              : std::chrono::nanoseconds(1))
+        , m_origin(clock_type::now())
+        , m_timer_valid(false)
+        , m_next_id(1)
+        , m_tick(0)
+        , m_armed(no_tick)
+    {
+        if (m_signum <= 0)
+            return;
+
+        ::sigevent event;
+        std::memset(&event, 0, sizeof(event));
+        event.sigev_signo = m_signum;
+        if (tid)
+        {
+            event.sigev_notify = SIGEV_THREAD_ID;
+            event.sigev_notify_thread_id = tid;
+        }
+        else
+        {
+            event.sigev_notify = SIGEV_SIGNAL;
+        }
+
+        m_timer_valid = (::timer_create(CLOCK_MONOTONIC, &event, &m_timer) == 0);
+    }
+
+    ~timer_service()
+    {
+        if (m_timer_valid)
+            ::timer_delete(m_timer);
+        if (m_owned)
+            rt::release(m_signum);
+    }
+
+    timer_service(const timer_service &) = delete;
+    timer_service &operator=(const timer_service &) = delete;
+
+    bool is_open() const noexcept { return m_timer_valid; }
+    signum_t signum() const noexcept { return m_signum; }
+
+    // Routes the timer signal to this service through loop.
+    bool attach(signal_loop &loop)
+    {
+        return loop.set_handler(m_signum, [this](int) {
+            expire();
+            return true;
+        });
+    }
+
+    bool attach() { return attach(signal_manager::loop()); }
+
+    timer_id schedule(const std::chrono::nanoseconds delay,
+                      const callback_type &callback)
+    {
+        return add(delay, std::chrono::nanoseconds(0), callback);
+    }
+
+    timer_id schedule_periodic(const std::chrono::nanoseconds period,
+                               const callback_type &callback)
+    {
+        return add(period, period, callback);
+    }
+
+    bool cancel(const timer_id id)
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+
+        std::unordered_map< timer_id, entry >::iterator it = m_timers.find(id);
+        if (it == m_timers.end())
+            return false;
+
+        unlink(id, it->second);
+        m_timers.erase(it);
+        return true;
+    }
+
+    std::size_t size() const
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        return m_timers.size();
+    }
+
+    // Runs every timer that is due and re-arms the kernel timer.  Returns the
+    // number of callbacks run.
+    std::size_t expire()
+    {
+        std::vector< callback_type > due;
+        {
+            std::lock_guard< std::mutex > lock(m_mutex);
+            advance(now_tick(), due);
+            m_armed = no_tick;
+            arm();
+        }
+
+        for (callback_type &callback : due) callback();
+        return due.size();
+    }
+
+   private:
+    static const std::uint64_t no_tick =
+        std::numeric_limits< std::uint64_t >::max();
+
+    struct entry
+    {
+        std::uint64_t expires;
+        std::uint64_t period;
+        std::size_t level;
+        std::size_t slot;
+        callback_type callback;
+    };
+
+    typedef std::vector< timer_id > slot_type;
+
+    timer_id add(const std::chrono::nanoseconds delay,
+                 const std::chrono::nanoseconds period,
+                 const callback_type &callback)
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+
+        if (m_timers.empty())
+            m_tick = now_tick();
+
+        const timer_id id = m_next_id++;
+        entry &e = m_timers[id];
+        e.expires = now_tick() + to_ticks(delay);
+        e.period = (period.count() > 0) ? to_ticks(period) : 0;
+        e.callback = callback;
+        link(id, e);
+
+        if (e.expires < m_armed)
+            arm();
+        return id;
+    }
+
+    std::uint64_t to_ticks(const std::chrono::nanoseconds delay) const
+    {
+        const std::uint64_t ticks =
+            (delay.count() + m_resolution.count() - 1) / m_resolution.count();
+        return (ticks > 0) ? ticks : 1;
+    }
+
+    std::uint64_t now_tick() const
+    {
+        return std::chrono::duration_cast< std::chrono::nanoseconds >(
+                   clock_type::now() - m_origin)
+                   .count() /
+               m_resolution.count();
+    }
+
+    void link(const timer_id id, entry &e)
+    {
+        const std::uint64_t delta = (e.expires > m_tick) ? e.expires - m_tick : 0;
+
+        std::size_t level = 0;
+        while (level + 1 < levels &&
+               delta >= (std::uint64_t(1) << (slot_bits * (level + 1))))
+            ++level;
+
+        // beyond the wheel's range, park in the outermost level and let it
+        // cascade again
+        std::uint64_t expires = e.expires;
+        const std::uint64_t range = std::uint64_t(1) << (slot_bits * levels);
+        if (delta >= range)
+            expires = m_tick + range - 1;
+
+        e.level = level;
+        e.slot = (expires >> (slot_bits * level)) & (slots - 1);
+        m_wheel[level][e.slot].push_back(id);
+    }
+
+    void unlink(const timer_id id, const entry &e)
+    {
+        slot_type &slot = m_wheel[e.level][e.slot];
+        for (std::size_t i = 0; i < slot.size(); ++i)
+        {
+            if (slot[i] == id)
+            {
+                slot[i] = slot.back();
+                slot.pop_back();
+                return;
+            }
+        }
+    }
+
+    void cascade(const std::size_t level, const std::size_t index)
+    {
+        slot_type ids;
+        ids.swap(m_wheel[level][index]);
+
+        for (timer_id id : ids) link(id, m_timers[id]);
+    }
+
+    void advance(const std::uint64_t target, std::vector< callback_type > &due)
+    {
+        if (m_timers.empty())
+        {
+            m_tick = target;
+            return;
+        }
+
+        while (m_tick < target)
+        {
+            ++m_tick;
+
+            for (std::size_t level = 1; level < levels; ++level)
+            {
+                const std::uint64_t mask =
+                    (std::uint64_t(1) << (slot_bits * level)) - 1;
+                if (m_tick & mask)
+                    break;
+                cascade(level,
+                        (m_tick >> (slot_bits * level)) & (slots - 1));
+            }
+
+            slot_type ids;
+            ids.swap(m_wheel[0][m_tick & (slots - 1)]);
+            for (timer_id id : ids)
+            {
+                std::unordered_map< timer_id, entry >::iterator it =
+                    m_timers.find(id);
+                entry &e = it->second;
+
+                if (e.expires > m_tick)
+                {
+                    link(id, e);
+                    continue;
+                }
+
+                due.push_back(e.callback);
+                if (e.period)
+                {
+                    e.expires += e.period;
+                    if (e.expires <= m_tick)
+                        e.expires = m_tick + e.period;
+                    link(id, e);
+                }
+                else
+                {
+                    m_timers.erase(it);
+                }
+            }
+        }
+    }
+
+    // The next tick that can have work: the first non-empty slot of the
+    // innermost level, or the first cascade of a non-empty outer slot.
+    std::uint64_t next_tick() const
+    {
+        std::uint64_t next = no_tick;
+        for (std::size_t level = 0; level < levels; ++level)
+        {
+            const std::size_t shift = slot_bits * level;
+            const std::uint64_t block = m_tick >> shift;
+            for (std::uint64_t b = block + 1; b <= block + slots; ++b)
+            {
+                if (!m_wheel[level][b & (slots - 1)].empty())
+                {
+                    if ((b << shift) < next)
+                        next = b << shift;
+                    break;
+                }
+            }
+        }
+        return next;
+    }
+
+    void arm()
+    {
+        const std::uint64_t next = next_tick();
+        if (!m_timer_valid || next == m_armed)
+            return;
+
+        m_armed = next;
+
+        ::itimerspec spec;
+        std::memset(&spec, 0, sizeof(spec));
+        if (next != no_tick)
+        {
+            const std::chrono::nanoseconds at =
+                std::chrono::duration_cast< std::chrono::nanoseconds >(
+                    m_origin.time_since_epoch()) +
+                m_resolution * next;
+            spec.it_value = impl::to_timespec(at);
+        }
+
+        ::timer_settime(m_timer, TIMER_ABSTIME, &spec, nullptr);
+    }
+
+   private:
+    signum_t m_signum;
+    bool m_owned;
+    std::chrono::nanoseconds m_resolution;
+    clock_type::time_point m_origin;
+    ::timer_t m_timer;
+    bool m_timer_valid;
+
+    mutable std::mutex m_mutex;
+    timer_id m_next_id;
+    std::uint64_t m_tick;
+    std::uint64_t m_armed;
+    std::unordered_map< timer_id, entry > m_timers;
+    std::array< std::array< slot_type, slots >, levels > m_wheel;
+};
+}  // namespace psig
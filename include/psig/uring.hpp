@@ -0,0 +1,170 @@
+/* Copyright (c) 2015, Chris Knight, Daniel C. Dillon
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <psig/psig.hpp>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+#include <linux/io_uring.h>
+
+namespace psig
+{
+// Consumes signals through an io_uring owned by the caller.  The reader keeps
+// a blocking signalfd for its set and fills submission entries that read up
+// to a batch of records from it; io_uring polls the descriptor internally, so
+// no thread blocks.  Each completion is converted and dispatched, and the
+// caller submits the next read.  Works with liburing or a hand-rolled ring,
+// since only the kernel's io_uring_sqe/io_uring_cqe layouts are used.
+class uring_signal_reader
+{
+   public:
+    typedef std::function< bool(const siginfo_span &) > batch_handler_type;
+
+    static const std::uint64_t default_user_data = 0x7073696700000000ull;
+
+    // Dispatches through the loop's registered handlers and statistics; the
+    // loop itself must not run.
+    explicit uring_signal_reader(signal_loop &loop,
+                                 const std::size_t batch = 16,
+                                 const std::uint64_t user_data =
+                                     default_user_data)
+        : m_handler([&loop](const siginfo_span &infos) {
+            bool keep_running = true;
+            for (const ::siginfo_t &info : infos)
+                keep_running = loop.dispatch(info) && keep_running;
+            return keep_running;
+        })
+        , m_infos(batch > 0 ? batch : 1)
+        , m_user_data(user_data)
+        , m_in_flight(false)
+        , m_finished(false)
+        , m_error(0)
+    {
+        open(loop.signals());
+    }
+
+    uring_signal_reader(const sigset &signals,
+                        const batch_handler_type &handler,
+                        const std::size_t batch = 16,
+                        const std::uint64_t user_data = default_user_data)
+        : m_handler(handler)
+        , m_infos(batch > 0 ? batch : 1)
+        , m_user_data(user_data)
+        , m_in_flight(false)
+        , m_finished(false)
+        , m_error(0)
+    {
+        open(signals);
+    }
+
+    uring_signal_reader(const uring_signal_reader &) = delete;
+    uring_signal_reader &operator=(const uring_signal_reader &) = delete;
+
+    bool is_open() const noexcept { return m_fd.is_open(); }
+    int fd() const noexcept { return m_fd.native_handle(); }
+    std::uint64_t user_data() const noexcept { return m_user_data; }
+
+    // A read is submitted and has not completed yet.
+    bool in_flight() const noexcept { return m_in_flight; }
+
+    // The handler asked to stop, or the read failed with error().
+    bool finished() const noexcept { return m_finished; }
+    int error() const noexcept { return m_error; }
+
+    // Fills sqe with the next read.  The buffer belongs to the reader, so
+    // only one read may be in flight at a time.
+    bool prepare(::io_uring_sqe *sqe) noexcept
+    {
+        if (sqe == nullptr || m_in_flight || m_finished || !is_open())
+            return false;
+
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = m_fd.native_handle();
+        sqe->off = ~std::uint64_t(0);
+        sqe->addr = reinterpret_cast< std::uintptr_t >(m_infos.data());
+        sqe->len =
+            static_cast< std::uint32_t >(m_infos.size() * sizeof(::siginfo_t));
+        sqe->user_data = m_user_data;
+
+        m_in_flight = true;
+        return true;
+    }
+
+    // Handles one completion.  Returns false when it belongs to another
+    // request; otherwise dispatches the records it carries.  Prepare the
+    // next read afterwards unless finished().
+    bool complete(const ::io_uring_cqe *cqe)
+    {
+        if (cqe == nullptr || cqe->user_data != m_user_data)
+            return false;
+
+        m_in_flight = false;
+
+        if (cqe->res < 0)
+        {
+            if (cqe->res != -EAGAIN && cqe->res != -EINTR)
+            {
+                m_error = -cqe->res;
+                m_finished = true;
+            }
+            return true;
+        }
+
+        const std::size_t records =
+            static_cast< std::size_t >(cqe->res) / sizeof(::signalfd_siginfo);
+        signal_fd::to_siginfo(m_infos.data(), records);
+
+        if (records > 0 && !m_handler(siginfo_span(m_infos.data(), records)))
+            m_finished = true;
+        return true;
+    }
+
+   private:
+    void open(const sigset &signals)
+    {
+        this_thread::add_mask(signals);
+        this_process::set_action(signals);
+        m_fd.open(signals);
+    }
+
+   private:
+    batch_handler_type m_handler;
+    signal_fd m_fd;
+    std::vector< ::siginfo_t > m_infos;
+    std::uint64_t m_user_data;
+    bool m_in_flight;
+    bool m_finished;
+    int m_error;
+};
+}  // namespace psig
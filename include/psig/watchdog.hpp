@@ -0,0 +1,388 @@
+/* Copyright (c) 2015, Chris Knight, Daniel C. Dillon
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <psig/psig.hpp>
+#include <psig/stack.hpp>
+#include <psig/timer.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <execinfo.h>
+
+extern "C" {
+inline void psig_stall_handler(int signum, ::siginfo_t *info, void *context);
+}
+
+namespace psig
+{
+// A registered thread that stopped beating, with the stack it was stuck in.
+// frames is empty if the thread could not run the capture handler, e.g.
+// because it blocks the watchdog signal.
+struct stall_report
+{
+    ::pid_t tid;
+    std::string name;
+    std::chrono::nanoseconds stalled;
+    std::vector< void * > frames;
+
+    // "thread 1234 (worker) stalled for 250 ms" followed by one symbolized
+    // frame per line, innermost first.
+    void write(std::ostream &out) const
+    {
+        out << "thread " << tid;
+        if (!name.empty())
+            out << " (" << name << ')';
+        out << " stalled for "
+            << std::chrono::duration_cast< std::chrono::milliseconds >(stalled)
+                   .count()
+            << " ms\n";
+        for (std::size_t i = 0; i < frames.size(); ++i)
+            out << "    " << impl::symbol(frames[i], i == 0) << '\n';
+        out.flush();
+    }
+};
+
+// Detects stalled threads.  Registered threads call beat() as they make
+// progress, e.g. once per event loop iteration.  A periodic timer checks the
+// beats on the timer service's loop thread; when a thread has not beaten for
+// the threshold, the watchdog sends it a reserved realtime signal with
+// tgkill().  Its handler copies the stack into the thread's preallocated
+// buffer and the next check reports it.  Each stall is reported once.
+class stall_watchdog
+{
+   public:
+    typedef std::size_t thread_handle;
+    typedef std::function< void(const stall_report &) > report_type;
+
+    static const thread_handle invalid_handle = ~thread_handle(0);
+    static const std::size_t max_depth = 64;
+
+    // Reports go to std::cerr unless report is given.  A signum of 0
+    // reserves a free realtime signal for the watchdog's lifetime; a given
+    // signum remains the caller's.
+    explicit stall_watchdog(
+        timer_service &timers,
+        const std::chrono::nanoseconds threshold = std::chrono::milliseconds(100),
+        const report_type &report = report_type(),
+        const std::size_t capacity = 64,
+        const signum_t signum = 0)
+        : m_timers(timers)
+        , m_signum(signum > 0 ? signum : rt::reserve())
+        , m_owned(signum <= 0 && m_signum > 0)
+        , m_threshold(threshold)
+        , m_report(report)
+        , m_slots(new slot[capacity])
+        , m_capacity(capacity)
+        , m_timer(0)
+        , m_stalls(0)
+    {
+        for (std::size_t i = 0; i < m_capacity; ++i)
+        {
+            m_slots[i].tid.store(0, std::memory_order_relaxed);
+            m_slots[i].beats.store(0, std::memory_order_relaxed);
+            m_slots[i].idle.store(false, std::memory_order_relaxed);
+            m_slots[i].capture.store(capture_none, std::memory_order_relaxed);
+            m_slots[i].blocked = false;
+        }
+
+        if (!impl::signal_owner< stall_watchdog >::set(m_signum, this))
+            return;
+
+        // the first backtrace() loads the unwinder, which must not happen
+        // inside the signal handler
+        void *warmup[1];
+        ::backtrace(warmup, 1);
+
+        struct ::sigaction action;
+        std::memset(&action, 0, sizeof(action));
+        ::sigfillset(&action.sa_mask);
+        action.sa_sigaction = &::psig_stall_handler;
+        action.sa_flags = SA_SIGINFO | SA_RESTART;
+        ::sigaction(m_signum, &action, &m_previous);
+
+        // check twice per threshold, so a stall is caught within 1.5 of it
+        const std::chrono::nanoseconds period =
+            (m_threshold / 2).count() > 0 ? m_threshold / 2
+                                          : std::chrono::nanoseconds(1);
+        m_timer = m_timers.schedule_periodic(period, [this]() { check(); });
+    }
+
+    ~stall_watchdog()
+    {
+        if (m_timer != 0)
+            m_timers.cancel(m_timer);
+
+        if (m_signum > 0
+            && m_signum < impl::signal_owner< stall_watchdog >::max_signum)
+        {
+            // ignoring the signal discards captures still queued; then wait
+            // for handlers already running before the slots go away
+            struct ::sigaction ignore;
+            std::memset(&ignore, 0, sizeof(ignore));
+            ignore.sa_handler = SIG_IGN;
+            ::sigaction(m_signum, &ignore, nullptr);
+            impl::signal_owner< stall_watchdog >::reset(m_signum);
+            ::sigaction(m_signum, &m_previous, nullptr);
+        }
+
+        if (m_owned)
+            rt::release(m_signum);
+    }
+
+    stall_watchdog(const stall_watchdog &) = delete;
+    stall_watchdog &operator=(const stall_watchdog &) = delete;
+
+    signum_t signum() const noexcept { return m_signum; }
+
+    // Registers the calling thread and unblocks the watchdog signal in it.
+    // Call unregister_thread() from the same thread before it exits.
+    thread_handle register_thread(const std::string &name = std::string())
+    {
+        if (m_timer == 0)
+            return invalid_handle;
+
+        std::lock_guard< std::mutex > lock(m_mutex);
+
+        const ::pid_t tid = static_cast< ::pid_t >(::syscall(SYS_gettid));
+        for (std::size_t i = 0; i < m_capacity; ++i)
+        {
+            slot &s = m_slots[i];
+            if (s.tid.load(std::memory_order_relaxed) != 0)
+                continue;
+
+            s.name = name;
+            s.idle.store(false, std::memory_order_relaxed);
+            s.capture.store(capture_none, std::memory_order_relaxed);
+            s.seen = s.beats.load(std::memory_order_relaxed);
+            s.changed = clock_type::now();
+            s.reported = false;
+            s.blocked = this_thread::sub_mask(m_signum).has(m_signum);
+            s.tid.store(tid, std::memory_order_release);
+            return i;
+        }
+
+        return invalid_handle;
+    }
+
+    // Call from the registered thread: the signal is blocked again if it was
+    // blocked before register_thread().
+    void unregister_thread(const thread_handle handle)
+    {
+        if (handle >= m_capacity)
+            return;
+
+        std::lock_guard< std::mutex > lock(m_mutex);
+
+        slot &s = m_slots[handle];
+        const ::pid_t tid = static_cast< ::pid_t >(::syscall(SYS_gettid));
+        if (s.tid.load(std::memory_order_relaxed) == tid && s.blocked)
+            this_thread::add_mask(m_signum);
+        s.tid.store(0, std::memory_order_relaxed);
+    }
+
+    // Marks progress on the calling thread.  Only the registered thread
+    // may beat its handle.
+    void beat(const thread_handle handle) noexcept
+    {
+        if (handle >= m_capacity)
+            return;
+
+        slot &s = m_slots[handle];
+        s.beats.store(s.beats.load(std::memory_order_relaxed) + 1,
+                      std::memory_order_relaxed);
+        s.idle.store(false, std::memory_order_relaxed);
+    }
+
+    // Exempts the thread until its next beat(), e.g. before it blocks
+    // waiting for work.
+    void idle(const thread_handle handle) noexcept
+    {
+        if (handle >= m_capacity)
+            return;
+
+        m_slots[handle].idle.store(true, std::memory_order_relaxed);
+    }
+
+    // Stalls reported so far.
+    std::uint64_t stalls() const
+    {
+        std::lock_guard< std::mutex > lock(m_mutex);
+        return m_stalls;
+    }
+
+    // Runs one check.  Called by the timer; returns the number of stalls
+    // reported.
+    std::size_t check()
+    {
+        std::vector< stall_report > reports;
+        {
+            std::lock_guard< std::mutex > lock(m_mutex);
+
+            const clock_type::time_point now = clock_type::now();
+            for (std::size_t i = 0; i < m_capacity; ++i)
+            {
+                slot &s = m_slots[i];
+                const ::pid_t tid = s.tid.load(std::memory_order_relaxed);
+                if (tid == 0)
+                    continue;
+
+                const std::uint64_t beats = s.beats.load(std::memory_order_relaxed);
+                if (beats != s.seen || s.idle.load(std::memory_order_relaxed))
+                {
+                    s.seen = beats;
+                    s.changed = now;
+                    s.reported = false;
+                    s.capture.store(capture_none, std::memory_order_relaxed);
+                    continue;
+                }
+
+                if (s.reported || now - s.changed < m_threshold)
+                    continue;
+
+                int expected = capture_none;
+                if (s.capture.compare_exchange_strong(expected, capture_requested))
+                {
+                    ::syscall(SYS_tgkill, ::getpid(), tid, m_signum);
+                    continue;
+                }
+
+                // the handler had a whole period to run; report what it
+                // left, possibly nothing
+                stall_report report;
+                report.tid = tid;
+                report.name = s.name;
+                report.stalled = now - s.changed;
+                if (s.capture.exchange(capture_none) == capture_done)
+                    report.frames.assign(s.frames, s.frames + s.depth);
+
+                s.reported = true;
+                ++m_stalls;
+                reports.push_back(std::move(report));
+            }
+        }
+
+        for (const stall_report &report : reports)
+        {
+            if (m_report)
+                m_report(report);
+            else
+                report.write(std::cerr);
+        }
+        return reports.size();
+    }
+
+    // Called from the signal handler on the stalled thread.
+    static void record(const signum_t signum, void *context) noexcept
+    {
+        const impl::signal_owner< stall_watchdog >::scope owner(signum);
+        stall_watchdog *self = owner.get();
+        if (self == nullptr)
+            return;
+
+        const ::pid_t tid = static_cast< ::pid_t >(::syscall(SYS_gettid));
+        for (std::size_t i = 0; i < self->m_capacity; ++i)
+        {
+            slot &s = self->m_slots[i];
+            if (s.tid.load(std::memory_order_acquire) != tid)
+                continue;
+
+            if (s.capture.load(std::memory_order_acquire) != capture_requested)
+                return;
+
+            const int depth = ::backtrace(s.frames, static_cast< int >(max_depth));
+            s.depth = impl::trim_stack(s.frames, depth > 0 ? depth : 0, context);
+
+            int expected = capture_requested;
+            s.capture.compare_exchange_strong(expected, capture_done);
+            return;
+        }
+    }
+
+   private:
+    typedef std::chrono::steady_clock clock_type;
+
+    enum
+    {
+        capture_none,
+        capture_requested,
+        capture_done
+    };
+
+    struct slot
+    {
+        std::atomic< ::pid_t > tid;
+        std::atomic< std::uint64_t > beats;
+        std::atomic< bool > idle;
+        std::atomic< int > capture;
+        std::size_t depth;
+        void *frames[max_depth];
+
+        // owned by the registered thread
+        bool blocked;
+
+        // owned by check()
+        std::string name;
+        std::uint64_t seen;
+        clock_type::time_point changed;
+        bool reported;
+    };
+
+   private:
+    timer_service &m_timers;
+    signum_t m_signum;
+    bool m_owned;
+    struct ::sigaction m_previous;
+    std::chrono::nanoseconds m_threshold;
+    report_type m_report;
+    std::unique_ptr< slot[] > m_slots;
+    std::size_t m_capacity;
+    timer_service::timer_id m_timer;
+    mutable std::mutex m_mutex;
+    std::uint64_t m_stalls;
+};
+}  // namespace psig
+
+extern "C" {
+inline void psig_stall_handler(int signum, ::siginfo_t *, void *context)
+{
+    const int saved = errno;
+    psig::stall_watchdog::record(signum, context);
+    errno = saved;
+}
+}
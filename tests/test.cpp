@@ -1,5 +1,26 @@
 #include <psig/psig.hpp>
+#include <psig/channel.hpp>
+#include <psig/coroutine.hpp>
+#include <psig/supervisor.hpp>
+#include <psig/interrupt.hpp>
+#include <psig/timer.hpp>
+#include <psig/router.hpp>
+#include <psig/fault.hpp>
+#include <psig/profiler.hpp>
+#include <psig/child.hpp>
+#include <psig/uring.hpp>
+#include <psig/reload.hpp>
+#include <psig/log.hpp>
+#include <psig/watchdog.hpp>
+#include <psig/shutdown.hpp>
 #include <iostream>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <fcntl.h>
 
 #define KTL_CHECK(cond)                            \
     if (!(cond))                                   \
@@ -17,7 +38,7 @@ void test_mask()
     kps::sigset cursigset = kps::this_thread::get_mask();
 
     std::cout << "Signals in new mask: ";
-    for (kps::signum_t signum : newsigset.signals()) std::cout << signum << " ";
+    for (kps::signum_t signum : newsigset) std::cout << signum << " ";
     std::cout << std::endl;
 
     KTL_CHECK(oldsigset.empty());
@@ -26,6 +47,7 @@ void test_mask()
     KTL_CHECK(newsigset.has(SIGTERM));
     KTL_CHECK(newsigset.has(SIGINT));
     KTL_CHECK(newsigset.has(SIGHUP) == false);
+    KTL_CHECK(newsigset.size() == 2);
 
     newsigset.clear();
     KTL_CHECK(newsigset.empty());
@@ -53,6 +75,1556 @@ void test_mask()
     KTL_CHECK(cursigset.has(kps::rt::signum(kps::rt::sigcount())));  // SIGRTMAX
 }
 
+void test_sigset()
+{
+    namespace kps = psig;
+
+    constexpr kps::sigset constsigset{SIGTERM, SIGINT, SIGHUP};
+    static_assert(constsigset.has(SIGHUP), "constexpr sigset");
+    static_assert(!constsigset.has(SIGUSR1), "constexpr sigset");
+
+    kps::sigset sigset = constsigset;
+    KTL_CHECK(sigset.size() == 3);
+
+    std::size_t count = 0;
+    kps::signum_t last = 0;
+    for (kps::signum_t signum : sigset)
+    {
+        KTL_CHECK(signum > last);
+        KTL_CHECK(constsigset.has(signum));
+        last = signum;
+        ++count;
+    }
+    KTL_CHECK(count == sigset.size());
+
+    sigset -= SIGINT;
+    sigset += kps::rt::sigmax();
+    KTL_CHECK(sigset.size() == 3);
+    KTL_CHECK(sigset.has(SIGINT) == false);
+    KTL_CHECK(sigset.has(kps::rt::sigmax()));
+    KTL_CHECK(kps::sigset(sigset.native_handle()) == sigset);
+    KTL_CHECK((sigset | kps::sigset(SIGINT)).size() == 4);
+    KTL_CHECK((sigset & constsigset).size() == 2);
+}
+
+void test_scoped_mask()
+{
+    namespace kps = psig;
+
+    const kps::sigset oldsigset = kps::this_thread::set_mask({SIGUSR1});
+    {
+        kps::this_thread::scoped_mask guard({SIGUSR1, SIGUSR2});
+        KTL_CHECK(guard.previous() == kps::sigset{SIGUSR1});
+        KTL_CHECK(kps::this_thread::get_mask() ==
+                  (kps::sigset{SIGUSR1, SIGUSR2}));
+        KTL_CHECK(kps::this_thread::refresh_mask() ==
+                  (kps::sigset{SIGUSR1, SIGUSR2}));
+    }
+    KTL_CHECK(kps::this_thread::get_mask() == kps::sigset{SIGUSR1});
+
+    kps::this_thread::add_mask(SIGHUP);
+    kps::this_thread::sub_mask(SIGUSR1);
+    kps::this_thread::add_mask({SIGKILL, SIGSTOP});
+    KTL_CHECK(kps::this_thread::get_mask() == kps::sigset{SIGHUP});
+    KTL_CHECK(kps::this_thread::refresh_mask() == kps::sigset{SIGHUP});
+
+    kps::this_thread::fill_mask();
+    const kps::sigset filled = kps::this_thread::get_mask();
+    KTL_CHECK(kps::this_thread::refresh_mask() == filled);
+
+    kps::this_thread::set_mask(oldsigset);
+}
+
+void test_signal_fd()
+{
+    namespace kps = psig;
+
+    kps::sigset signals{SIGUSR1, SIGUSR2};
+    const kps::sigset oldsigset = kps::this_thread::add_mask(signals);
+
+    kps::signal_fd fd(signals);
+    KTL_CHECK(fd.is_open());
+
+    ::siginfo_t info;
+    KTL_CHECK(kps::wait(fd, std::chrono::nanoseconds(1000000), &info) < 0);
+
+    ::kill(::getpid(), SIGUSR2);
+    KTL_CHECK(kps::wait(fd, &info) == SIGUSR2);
+    KTL_CHECK(info.si_signo == SIGUSR2);
+    KTL_CHECK(info.si_pid == ::getpid());
+
+    kps::this_thread::set_mask(oldsigset);
+}
+
+void test_wait_batch()
+{
+    namespace kps = psig;
+
+    const kps::signum_t signum = kps::rt::signum(1);
+    const kps::sigset signals(signum);
+    const kps::sigset oldsigset = kps::this_thread::add_mask(signals);
+    kps::signal_fd fd(signals);
+
+    ::siginfo_t infos[16];
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        for (int i = 0; i < 10; ++i)
+        {
+            ::sigval value;
+            value.sival_int = i;
+            ::sigqueue(::getpid(), signum, value);
+        }
+
+        const ::ssize_t count = (pass == 0)
+                                    ? kps::wait_batch(signals, infos, 16)
+                                    : kps::wait_batch(fd, infos, 16);
+        KTL_CHECK(count == 10);
+
+        kps::siginfo_span span(infos, count);
+        int expected = 0;
+        for (const ::siginfo_t &info : span)
+        {
+            KTL_CHECK(info.si_signo == signum);
+            KTL_CHECK(info.si_code == SI_QUEUE);
+            KTL_CHECK(info.si_value.sival_int == expected++);
+        }
+    }
+
+    kps::this_thread::set_mask(oldsigset);
+}
+
+void test_dispatch()
+{
+    namespace kps = psig;
+
+    int hups = 0;
+    kps::handler_table table;
+    KTL_CHECK(table.set(SIGHUP, [&](int) { return ++hups > 0; }));
+    KTL_CHECK(table.set(kps::rt::sigmax(), [](int) { return true; }));
+    KTL_CHECK(table.set(0, [](int) { return true; }) == false);
+    KTL_CHECK(table.has(SIGHUP));
+    KTL_CHECK(table(SIGHUP) && hups == 1);
+    KTL_CHECK(table(kps::rt::sigmax()));
+    KTL_CHECK(table(SIGTERM) == false);
+    table.erase(SIGHUP);
+    KTL_CHECK(table(SIGHUP) == false && hups == 1);
+
+    int usr1s = 0;
+    auto dispatcher =
+        kps::make_dispatcher(kps::on< SIGUSR1 >([&](int) { return ++usr1s > 0; }),
+                             kps::on< SIGTERM >([](int) { return false; }));
+    static_assert(decltype(dispatcher)::signals().has(SIGUSR1),
+                  "static dispatcher signals");
+    KTL_CHECK(dispatcher(SIGUSR1) && usr1s == 1);
+    KTL_CHECK(dispatcher(SIGTERM) == false);
+    KTL_CHECK(dispatcher(SIGHUP) == false);
+    KTL_CHECK(dispatcher(0) == false);
+}
+
+void test_channel()
+{
+    namespace kps = psig;
+
+    struct payload
+    {
+        std::int32_t id;
+        std::int32_t value;
+    };
+
+    kps::rt::channel< payload > channel;
+    KTL_CHECK(channel.is_open());
+    KTL_CHECK(kps::rt::reserved(channel.signum()));
+    KTL_CHECK(kps::rt::reserve(channel.signum()) == false);
+    KTL_CHECK(!kps::rt::channel< payload >(channel.signum()).is_open());
+    KTL_CHECK(kps::rt::reserved(channel.signum()));
+
+    for (std::int32_t i = 0; i < 8; ++i)
+        KTL_CHECK(channel.send(::getpid(), payload{i, i * 10}));
+
+    kps::rt::channel< payload >::message_type msg;
+    KTL_CHECK(channel.receive(msg));
+    KTL_CHECK(msg.payload.id == 0 && msg.payload.value == 0);
+    KTL_CHECK(msg.pid == ::getpid());
+
+    kps::rt::channel< payload >::message_type msgs[16];
+    KTL_CHECK(channel.receive(msgs, 16) == 7);
+    KTL_CHECK(msgs[6].payload.id == 7 && msgs[6].payload.value == 70);
+}
+
+void test_stats()
+{
+    namespace kps = psig;
+
+    std::unique_ptr< kps::signal_statistics > stats(
+        new kps::signal_statistics);
+    stats->set_timestamped(kps::sigset(kps::rt::sigmin()));
+
+    const kps::signal_statistics::clock_type::time_point start =
+        kps::signal_statistics::clock_type::now();
+
+    ::siginfo_t info;
+    std::memset(&info, 0, sizeof(info));
+    info.si_signo = SIGHUP;
+    stats->record(info, start, start + std::chrono::microseconds(3));
+    stats->record(info, start, start + std::chrono::microseconds(3));
+
+    info.si_signo = kps::rt::sigmin();
+    info.si_code = SI_QUEUE;
+    info.si_value = kps::rt::timestamp();
+    stats->record(info, kps::signal_statistics::clock_type::now(),
+                  kps::signal_statistics::clock_type::now());
+
+    const kps::stats_snapshot snapshot = stats->snapshot();
+    KTL_CHECK(snapshot.delivered() == 3);
+    KTL_CHECK(snapshot[SIGHUP].delivered == 2);
+    KTL_CHECK(snapshot[SIGHUP].handler_nsec.total() == 2);
+    KTL_CHECK(snapshot[SIGHUP].handler_nsec.counts[kps::histogram::bucket(
+                  3000)] == 2);
+    KTL_CHECK(snapshot[SIGHUP].queue_wait_nsec.total() == 0);
+    KTL_CHECK(snapshot[kps::rt::sigmin()].queue_wait_nsec.total() == 1);
+    KTL_CHECK(snapshot[SIGTERM].delivered == 0);
+}
+
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+struct detached_task
+{
+    struct promise_type
+    {
+        detached_task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+detached_task await_signals(psig::poll_executor &executor,
+                            const psig::sigset &signals,
+                            int &received)
+{
+    const ::siginfo_t info = co_await psig::async_wait(signals, executor);
+    received = info.si_signo;
+
+    psig::signal_stream< psig::poll_executor > stream(signals, executor);
+    for (int i = 0; i < 3; ++i)
+    {
+        const ::siginfo_t next = co_await stream.next();
+        KTL_CHECK(next.si_value.sival_int == i);
+        ++received;
+    }
+}
+
+void test_coroutine()
+{
+    namespace kps = psig;
+
+    const kps::sigset signals{SIGUSR1, kps::rt::sigmin()};
+    const kps::sigset oldsigset = kps::this_thread::add_mask(signals);
+
+    kps::poll_executor executor;
+    int received = 0;
+    await_signals(executor, signals, received);
+    KTL_CHECK(received == 0 && !executor.empty());
+
+    ::raise(SIGUSR1);
+    KTL_CHECK(executor.run_once(1000) == 1);
+    KTL_CHECK(received == SIGUSR1);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        ::sigval value;
+        value.sival_int = i;
+        ::sigqueue(::getpid(), kps::rt::sigmin(), value);
+    }
+    KTL_CHECK(executor.run_once(1000) == 1);
+    KTL_CHECK(received == SIGUSR1 + 3);
+    KTL_CHECK(executor.empty());
+
+    kps::this_thread::set_mask(oldsigset);
+}
+#else
+void test_coroutine() {}
+#endif
+
+void test_supervisor()
+{
+    namespace kps = psig;
+
+    kps::supervisor supervisor;
+    std::vector< ::pid_t > children;
+    for (int i = 0; i < 4; ++i)
+    {
+        const ::pid_t pid = ::fork();
+        if (pid == 0)
+        {
+            kps::this_thread::clear_mask();
+            ::pause();
+            ::_exit(0);
+        }
+        children.push_back(pid);
+        KTL_CHECK(supervisor.add(pid));
+    }
+    KTL_CHECK(supervisor.size() == 4);
+
+    KTL_CHECK(supervisor.send(children[0], SIGTERM));
+
+    // a staggered broadcast does not hold up the other operations
+    std::thread broadcaster([&]() {
+        KTL_CHECK(supervisor.broadcast(
+                      SIGTERM,
+                      kps::supervisor::fanout(1, std::chrono::milliseconds(100))) ==
+                  4);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    KTL_CHECK(supervisor.size() == 4);
+    KTL_CHECK(std::chrono::steady_clock::now() - start <
+              std::chrono::milliseconds(50));
+    broadcaster.join();
+
+    for (::pid_t pid : children)
+    {
+        int status = 0;
+        KTL_CHECK(::waitpid(pid, &status, 0) == pid);
+        KTL_CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGTERM);
+    }
+    KTL_CHECK(supervisor.remove(children[1]));
+    KTL_CHECK(supervisor.size() == 3);
+    KTL_CHECK(supervisor.prune().size() == 3);
+    KTL_CHECK(supervisor.size() == 0);
+
+    // forward() relays a signal from any loop
+    const kps::sigset oldsigset = kps::this_thread::get_mask();
+    children.clear();
+    for (int i = 0; i < 2; ++i)
+    {
+        const ::pid_t pid = ::fork();
+        if (pid == 0)
+        {
+            kps::this_thread::clear_mask();
+            ::pause();
+            ::_exit(0);
+        }
+        children.push_back(pid);
+        KTL_CHECK(supervisor.add(pid));
+    }
+
+    kps::signal_loop loop;
+    KTL_CHECK(supervisor.forward(loop, SIGUSR2));
+    KTL_CHECK(loop.block_signals(kps::sigset(SIGUSR2)));
+    loop.exec_async();
+    ::kill(::getpid(), SIGUSR2);
+
+    for (::pid_t pid : children)
+    {
+        int status = 0;
+        KTL_CHECK(::waitpid(pid, &status, 0) == pid);
+        KTL_CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGUSR2);
+    }
+    loop.stop();
+    KTL_CHECK(supervisor.prune().size() == 2);
+
+    kps::this_thread::set_mask(oldsigset);
+}
+
+void test_timer()
+{
+    namespace kps = psig;
+
+    kps::timer_service timers(std::chrono::milliseconds(1));
+    KTL_CHECK(timers.is_open());
+
+    const kps::sigset signals(timers.signum());
+    const kps::sigset oldsigset = kps::this_thread::add_mask(signals);
+
+    int once = 0;
+    int periodic = 0;
+    int cancelled = 0;
+    timers.schedule(std::chrono::milliseconds(5), [&]() { ++once; });
+    timers.schedule_periodic(std::chrono::milliseconds(2),
+                             [&]() { ++periodic; });
+    const kps::timer_service::timer_id id = timers.schedule(
+        std::chrono::milliseconds(3), [&]() { ++cancelled; });
+    timers.schedule(std::chrono::seconds(100), []() {});
+    KTL_CHECK(timers.size() == 4);
+    KTL_CHECK(timers.cancel(id));
+    KTL_CHECK(timers.cancel(id) == false);
+
+    while (periodic < 10)
+    {
+        KTL_CHECK(kps::wait(signals, std::chrono::seconds(1)) ==
+                  timers.signum());
+        timers.expire();
+    }
+
+    KTL_CHECK(once == 1);
+    KTL_CHECK(cancelled == 0);
+    KTL_CHECK(timers.size() == 2);
+
+    // a signal passed in stays reserved by its owner
+    const kps::signum_t owned = kps::rt::reserve();
+    {
+        kps::timer_service borrowed(std::chrono::milliseconds(1), owned);
+        KTL_CHECK(borrowed.signum() == owned);
+    }
+    KTL_CHECK(kps::rt::reserved(owned));
+    kps::rt::release(owned);
+
+    kps::this_thread::set_mask(oldsigset);
+}
+
+void test_interrupt()
+{
+    namespace kps = psig;
+
+    const kps::signum_t signum = kps::rt::reserve();
+    struct ::sigaction before;
+    ::sigaction(signum, nullptr, &before);
+
+    std::unique_ptr< kps::thread_interrupter > interrupter(
+        new kps::thread_interrupter(4, signum));
+    std::atomic< kps::thread_interrupter::thread_handle > handle(
+        kps::thread_interrupter::invalid_handle);
+    std::atomic< kps::thread_interrupter::reason_type > reasons(0);
+    std::atomic< bool > reblocked(false);
+    int fds[2];
+    KTL_CHECK(::pipe(fds) == 0);
+
+    std::thread worker([&]() {
+        // registering unblocks the signal; unregistering blocks it again
+        kps::this_thread::add_mask(signum);
+        handle = interrupter->register_thread();
+        KTL_CHECK(!kps::this_thread::get_mask().has(signum));
+
+        char c;
+        while (::read(fds[0], &c, 1) < 0 && errno == EINTR)
+        {
+            reasons = interrupter->take(handle);
+            if (reasons)
+                break;
+        }
+        interrupter->unregister_thread(handle);
+        reblocked = kps::this_thread::get_mask().has(signum);
+    });
+
+    while (handle == kps::thread_interrupter::invalid_handle)
+        std::this_thread::yield();
+
+    while (reasons == 0)
+    {
+        interrupter->interrupt(handle, 0x5);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    worker.join();
+
+    KTL_CHECK(reasons == 0x5);
+    KTL_CHECK(interrupter->interrupt(handle, 1) == false);
+    KTL_CHECK(reblocked);
+    ::close(fds[0]);
+    ::close(fds[1]);
+
+    // the previous action is restored and the signal stays reserved
+    interrupter.reset();
+    struct ::sigaction after;
+    ::sigaction(signum, nullptr, &after);
+    KTL_CHECK(after.sa_handler == before.sa_handler);
+    KTL_CHECK(kps::rt::reserved(signum));
+    kps::rt::release(signum);
+}
+
+void test_router()
+{
+    namespace kps = psig;
+
+    const kps::sigset oldsigset = kps::this_thread::get_mask();
+    const kps::signum_t rtsig = kps::rt::reserve();
+    KTL_CHECK(rtsig > 0);
+
+    std::atomic< int > delivered(0);
+    std::atomic< bool > overlapped(false);
+
+    kps::signal_router router(2);
+    KTL_CHECK(router.route(SIGUSR2, 1, [](int) { return true; }));
+    KTL_CHECK(router.route(SIGUSR2, 0, [&](int) {
+        // a slow handler must not hold up the other shard
+        const auto deadline =
+            std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (delivered < 5 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        overlapped = (delivered == 5);
+        return false;
+    }));
+    KTL_CHECK(router.route(rtsig, 1, [&](int) {
+        ++delivered;
+        return true;
+    }));
+    KTL_CHECK(router.shard_of(SIGUSR2) == 0);
+    KTL_CHECK(router.shard_of(rtsig) == 1);
+    KTL_CHECK(router.shard_of(SIGUSR1) == kps::signal_router::npos);
+    KTL_CHECK(router.route(SIGUSR1, 2, [](int) { return true; }) == false);
+
+    KTL_CHECK(router.block_signals());
+    router.exec_async();
+
+    ::kill(::getpid(), SIGUSR2);
+    for (int i = 0; i < 5; ++i)
+    {
+        ::sigval value;
+        value.sival_int = i;
+        KTL_CHECK(::sigqueue(::getpid(), rtsig, value) == 0);
+    }
+
+    router.wait();
+    KTL_CHECK(overlapped);
+    KTL_CHECK(router.shard(0).finished());
+    KTL_CHECK(router.shard(1).finished());
+
+    kps::rt::release(rtsig);
+    kps::this_thread::set_mask(oldsigset);
+}
+
+void test_thread_options()
+{
+    namespace kps = psig;
+
+    const kps::sigset oldsigset = kps::this_thread::get_mask();
+    const kps::signum_t rtsig = kps::rt::reserve();
+    KTL_CHECK(rtsig > 0);
+
+    kps::thread_options options;
+    options.cpus.push_back(0);
+    options.stack_size = 1 << 20;
+    options.name = "psig-test-loop-name";
+
+    std::string name;
+    std::size_t stack_size = 0;
+    bool pinned = false;
+
+    kps::signal_loop loop;
+    loop.set_thread_options(options);
+    loop.set_handler(rtsig, [&](int) {
+        char buffer[16];
+        ::pthread_getname_np(::pthread_self(), buffer, sizeof(buffer));
+        name = buffer;
+
+        ::pthread_attr_t attr;
+        ::pthread_getattr_np(::pthread_self(), &attr);
+        ::pthread_attr_getstacksize(&attr, &stack_size);
+        ::pthread_attr_destroy(&attr);
+
+        ::cpu_set_t set;
+        ::sched_getaffinity(0, sizeof(set), &set);
+        pinned = (CPU_COUNT(&set) == 1 && CPU_ISSET(0, &set));
+        return false;
+    });
+
+    KTL_CHECK(loop.block_signals(kps::sigset()));
+    loop.exec_async();
+
+    ::sigval value;
+    value.sival_int = 0;
+    KTL_CHECK(::sigqueue(::getpid(), rtsig, value) == 0);
+    loop.wait_for_exec_async();
+
+    KTL_CHECK(loop.thread_error() == 0);
+    KTL_CHECK(name == "psig-test-loop-");
+    KTL_CHECK(stack_size >= options.stack_size);
+    KTL_CHECK(pinned);
+
+    kps::thread_options invalid;
+    invalid.policy = 12345;
+    KTL_CHECK(invalid.apply() == EINVAL);
+
+    kps::rt::release(rtsig);
+    kps::this_thread::set_mask(oldsigset);
+}
+
+void test_replace_handlers()
+{
+    namespace kps = psig;
+
+    const kps::sigset oldsigset = kps::this_thread::get_mask();
+    const kps::signum_t rtsig = kps::rt::reserve();
+    KTL_CHECK(rtsig > 0);
+
+    std::atomic< int > first(0);
+    std::atomic< int > second(0);
+
+    kps::handler_table tables[2];
+    tables[0].set(rtsig, [&](int) {
+        ++first;
+        return true;
+    });
+    tables[1].set(rtsig, [&](int) {
+        ++second;
+        return true;
+    });
+
+    kps::signal_loop loop;
+    loop.replace_handlers(tables[0]);
+    KTL_CHECK(loop.handlers().has(rtsig));
+    KTL_CHECK(loop.block_signals(kps::sigset(rtsig)));
+    loop.exec_async();
+
+    // swap while the loop runs; every signal is handled by the table that
+    // was current when it was dispatched
+    const std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    for (int round = 0; round < 20; ++round)
+    {
+        loop.replace_handlers(tables[round % 2]);
+
+        for (int i = 0; i < 10; ++i)
+        {
+            ::sigval value;
+            value.sival_int = i;
+            KTL_CHECK(::sigqueue(::getpid(), rtsig, value) == 0);
+        }
+
+        while (first + second < (round + 1) * 10 &&
+               std::chrono::steady_clock::now() < deadline)
+            std::this_thread::yield();
+    }
+    loop.stop();
+
+    KTL_CHECK(first == 100);
+    KTL_CHECK(second == 100);
+
+    kps::rt::release(rtsig);
+    kps::this_thread::set_mask(oldsigset);
+}
+
+void test_change_handlers()
+{
+    namespace kps = psig;
+
+    const kps::sigset oldsigset = kps::this_thread::get_mask();
+    const kps::signum_t rtsig = kps::rt::reserve();
+    const kps::signum_t added = kps::rt::reserve();
+    KTL_CHECK(rtsig > 0 && added > 0);
+
+    const kps::signal_loop::backend backends[] = {
+        kps::signal_loop::backend::sigwait, kps::signal_loop::backend::signalfd};
+    for (const kps::signal_loop::backend backend : backends)
+    {
+        std::atomic< int > usr1s(0);
+        std::atomic< int > usr2s(0);
+        std::atomic< int > late(0);
+
+        kps::signal_loop loop;
+        loop.set_backend(backend);
+        KTL_CHECK(loop.set_handler(SIGUSR1, [&](int) { return ++usr1s > 0; }));
+        KTL_CHECK(loop.set_handler(SIGUSR2, [&](int) { return ++usr2s > 0; }));
+        KTL_CHECK(loop.block_signals(kps::sigset(SIGUSR1)));
+
+        // a handler set after block_signals() is waited on
+        KTL_CHECK(loop.set_handler(rtsig, [&](int) { return ++late > 0; }));
+        KTL_CHECK(loop.signals().has(rtsig));
+        loop.exec_async();
+
+        const std::chrono::steady_clock::time_point deadline =
+            std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        ::sigval value;
+        value.sival_int = 0;
+        KTL_CHECK(::sigqueue(::getpid(), rtsig, value) == 0);
+        while (late == 0 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::yield();
+        KTL_CHECK(late == 1);
+
+        // a cleared handler's signal is consumed and the loop keeps running
+        loop.clear_handler(SIGUSR2);
+        ::kill(::getpid(), SIGUSR2);
+        while (loop.stats()[SIGUSR2].delivered == 0 && !loop.finished() &&
+               std::chrono::steady_clock::now() < deadline)
+            std::this_thread::yield();
+        KTL_CHECK(!loop.finished());
+
+        ::kill(::getpid(), SIGUSR1);
+        while (usr1s == 0 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::yield();
+        KTL_CHECK(usr1s == 1);
+        KTL_CHECK(usr2s == 0);
+
+        // and one set while the loop runs is waited on too
+        KTL_CHECK(loop.set_handler(added, [&](int) { return ++late > 0; }));
+        KTL_CHECK(::sigqueue(::getpid(), added, value) == 0);
+        while (late == 1 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::yield();
+        KTL_CHECK(late == 2);
+
+        loop.stop();
+    }
+
+    kps::rt::release(added);
+    kps::rt::release(rtsig);
+    kps::this_thread::set_mask(oldsigset);
+}
+
+bool test_fault_hook(const ::siginfo_t &info, void *user)
+{
+    ++*static_cast< int * >(user);
+
+    const std::uintptr_t page =
+        static_cast< std::uintptr_t >(::sysconf(_SC_PAGESIZE));
+    void *base = reinterpret_cast< void * >(
+        reinterpret_cast< std::uintptr_t >(info.si_addr) & ~(page - 1));
+    return (::mmap(base, page, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED,
+                   -1, 0) != MAP_FAILED);
+}
+
+void test_fault()
+{
+    namespace kps = psig;
+
+    const std::size_t page = static_cast< std::size_t >(::sysconf(_SC_PAGESIZE));
+    char path[] = "/tmp/psig-fault-XXXXXX";
+    const int fd = ::mkstemp(path);
+    KTL_CHECK(fd >= 0);
+    ::unlink(path);
+    KTL_CHECK(::ftruncate(fd, 3 * page) == 0);
+
+    char *data = static_cast< char * >(
+        ::mmap(nullptr, 3 * page, PROT_READ, MAP_SHARED, fd, 0));
+    KTL_CHECK(data != MAP_FAILED);
+
+    // every page now lies past the end of the file
+    KTL_CHECK(::ftruncate(fd, 0) == 0);
+
+    const kps::fault::region_id recover =
+        kps::fault::add_recover(data, page, EIO);
+    const kps::fault::region_id zero =
+        kps::fault::add_zero_fill(data + page, page);
+    int hooked = 0;
+    const kps::fault::region_id hook =
+        kps::fault::add_hook(data + 2 * page, page, &test_fault_hook, &hooked);
+    KTL_CHECK(recover != kps::fault::invalid_region);
+    KTL_CHECK(zero != kps::fault::invalid_region);
+    KTL_CHECK(hook != kps::fault::invalid_region);
+
+    volatile char c = 1;
+    void *address = nullptr;
+    KTL_CHECK(kps::fault::protect([&]() { c = data[10]; }, &address) == EIO);
+    KTL_CHECK(address == data + 10);
+    KTL_CHECK(kps::fault::protect([&]() { c = data[10]; }) == EIO);
+
+    KTL_CHECK(kps::fault::protect([&]() { c = data[page + 10]; }) == 0);
+    KTL_CHECK(c == 0);
+
+    c = 1;
+    c = data[2 * page + 10];
+    KTL_CHECK(c == 0);
+    KTL_CHECK(hooked == 1);
+
+    KTL_CHECK(kps::fault::remove(recover));
+    KTL_CHECK(kps::fault::remove(recover) == false);
+    KTL_CHECK(kps::fault::remove(zero));
+    KTL_CHECK(kps::fault::remove(hook));
+
+    ::munmap(data, 3 * page);
+    ::close(fd);
+
+    // a sent SIGSEGV is not a fault: it takes the default action
+    const ::pid_t pid = ::fork();
+    if (pid == 0)
+    {
+        const ::rlimit no_core = {0, 0};
+        ::setrlimit(RLIMIT_CORE, &no_core);
+        ::raise(SIGSEGV);
+        ::_exit(0);
+    }
+    int status = 0;
+    KTL_CHECK(::waitpid(pid, &status, 0) == pid);
+    KTL_CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV);
+}
+
+void test_profiler()
+{
+    namespace kps = psig;
+
+    kps::profiler profiler(1000);
+    KTL_CHECK(profiler.signum() > 0);
+
+    std::atomic< bool > registered(false);
+    std::thread worker([&]() {
+        const kps::profiler::thread_handle handle = profiler.register_thread();
+        KTL_CHECK(handle != kps::profiler::invalid_handle);
+        registered = true;
+
+        ::timespec start;
+        ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+        for (;;)
+        {
+            ::timespec now;
+            ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+            if ((now.tv_sec - start.tv_sec) * 1000000000L + now.tv_nsec -
+                    start.tv_nsec >
+                200000000L)
+                break;
+        }
+
+        profiler.unregister_thread(handle);
+    });
+
+    while (!registered)
+        std::this_thread::yield();
+    profiler.start();
+    KTL_CHECK(profiler.running());
+    worker.join();
+    profiler.stop();
+
+    const std::size_t drained = profiler.drain();
+    KTL_CHECK(drained > 0);
+    KTL_CHECK(profiler.samples() == drained);
+
+    std::ostringstream folded;
+    profiler.write_folded(folded);
+
+    std::uint64_t total = 0;
+    std::istringstream lines(folded.str());
+    std::string line;
+    while (std::getline(lines, line))
+        total += std::strtoull(line.c_str() + line.rfind(' ') + 1, nullptr, 10);
+    KTL_CHECK(total == drained);
+
+    profiler.clear();
+    KTL_CHECK(profiler.samples() == 0);
+}
+
+void test_profiler_attach()
+{
+    namespace kps = psig;
+
+    const kps::sigset oldsigset = kps::this_thread::get_mask();
+    char path[] = "/tmp/psig_profile_XXXXXX";
+    const int fd = ::mkstemp(path);
+    KTL_CHECK(fd >= 0);
+    ::close(fd);
+
+    // a ring holds 64 ms of samples; the periodic drain keeps up with
+    // 300 ms of sampling
+    {
+        kps::profiler profiler(1000, 4, 64);
+        KTL_CHECK(profiler.attach(path, SIGUSR2));
+        KTL_CHECK(kps::signal_manager::block_signals(kps::sigset(SIGUSR2)));
+        kps::signal_manager::exec_async();
+
+        std::atomic< bool > registered(false);
+        std::thread worker([&]() {
+            const kps::profiler::thread_handle handle = profiler.register_thread();
+            registered = true;
+            while (!profiler.running())
+                std::this_thread::yield();
+
+            ::timespec start;
+            ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+            for (;;)
+            {
+                ::timespec now;
+                ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+                if ((now.tv_sec - start.tv_sec) * 1000000000L + now.tv_nsec -
+                        start.tv_nsec >
+                    300000000L)
+                    break;
+            }
+            profiler.unregister_thread(handle);
+        });
+
+        while (!registered)
+            std::this_thread::yield();
+        ::kill(::getpid(), SIGUSR2);
+        worker.join();
+        ::kill(::getpid(), SIGUSR2);
+
+        const std::chrono::steady_clock::time_point deadline =
+            std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (profiler.running() && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::yield();
+        kps::signal_manager::stop();
+
+        KTL_CHECK(!profiler.running());
+        KTL_CHECK(profiler.samples() > 64);
+        KTL_CHECK(profiler.dropped() == 0);
+    }
+
+    // destroying a profiler attached to a running loop leaves the loop
+    // running, and a late toggle signal is consumed
+    {
+        std::atomic< int > usr1s(0);
+        kps::signal_loop loop;
+        KTL_CHECK(loop.set_handler(SIGUSR1, [&](int) { return ++usr1s > 0; }));
+        KTL_CHECK(loop.block_signals(kps::sigset(SIGUSR1)));
+        loop.exec_async();
+
+        {
+            kps::profiler profiler(1000, 4, 64);
+            KTL_CHECK(profiler.attach(loop, path, SIGUSR2));
+            KTL_CHECK(loop.signals().has(SIGUSR2));
+        }
+
+        ::kill(::getpid(), SIGUSR2);
+        const std::chrono::steady_clock::time_point deadline =
+            std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (loop.stats()[SIGUSR2].delivered == 0 && !loop.finished() &&
+               std::chrono::steady_clock::now() < deadline)
+            std::this_thread::yield();
+        KTL_CHECK(!loop.finished());
+
+        ::kill(::getpid(), SIGUSR1);
+        while (usr1s == 0 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::yield();
+        KTL_CHECK(usr1s == 1);
+        loop.stop();
+    }
+
+    ::unlink(path);
+    kps::this_thread::set_mask(oldsigset);
+}
+
+void test_stop()
+{
+    namespace kps = psig;
+
+    const kps::sigset oldsigset = kps::this_thread::get_mask();
+
+    std::atomic< int > handled(0);
+    kps::signal_loop loop;
+    loop.set_handler(SIGUSR1, [&](int) {
+        ++handled;
+        return true;
+    });
+    KTL_CHECK(loop.block_signals(kps::sigset(SIGUSR1), std::chrono::seconds(10)));
+    loop.exec_async();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    // the wake-up goes to the loop thread only and is not dispatched; the
+    // loop does not sit out its timeout
+    const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    loop.stop();
+    KTL_CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+    KTL_CHECK(loop.finished());
+    KTL_CHECK(handled == 0);
+    KTL_CHECK(loop.stats().delivered() == 0);
+
+    // an application that waits on the wake signal itself still gets its
+    // deliveries, and stop() still wakes the loop
+    const kps::signum_t wake = kps::impl::wake_signal();
+    KTL_CHECK(wake > 0);
+    const kps::signal_loop::backend backends[] = {
+        kps::signal_loop::backend::sigwait, kps::signal_loop::backend::signalfd};
+    for (const kps::signal_loop::backend backend : backends)
+    {
+        std::atomic< int > woken(0);
+        kps::signal_loop shared;
+        shared.set_backend(backend);
+        KTL_CHECK(shared.set_handler(wake, [&](int) { return ++woken > 0; }));
+        KTL_CHECK(shared.block_signals(kps::sigset{SIGUSR1, wake},
+                                       std::chrono::seconds(10)));
+        shared.exec_async();
+
+        ::kill(::getpid(), wake);
+        const std::chrono::steady_clock::time_point deadline =
+            std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (woken == 0 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::yield();
+        KTL_CHECK(woken == 1);
+
+        const std::chrono::steady_clock::time_point stopping =
+            std::chrono::steady_clock::now();
+        shared.stop();
+        KTL_CHECK(std::chrono::steady_clock::now() - stopping <
+                  std::chrono::seconds(1));
+        KTL_CHECK(woken == 1);
+    }
+
+    kps::this_thread::set_mask(oldsigset);
+}
+
+void test_child_monitor()
+{
+    namespace kps = psig;
+
+    const kps::sigset oldsigset = kps::this_thread::add_mask(SIGCHLD);
+
+    kps::child_monitor monitor;
+    const int count = 64;
+    std::vector< ::pid_t > pids;
+    for (int i = 0; i < count; ++i)
+    {
+        const ::pid_t pid = ::fork();
+        if (pid == 0)
+            ::_exit(i);
+        KTL_CHECK(pid > 0);
+        pids.push_back(pid);
+    }
+
+    // the last child is watched only after it has been reaped
+    int called = 0;
+    std::vector< std::future< kps::child_exit > > futures;
+    for (int i = 0; i < count - 1; ++i)
+    {
+        if (i % 2)
+        {
+            futures.push_back(monitor.watch(pids[i]));
+            continue;
+        }
+
+        KTL_CHECK(monitor.watch(pids[i], [&, i](const kps::child_exit &status) {
+            KTL_CHECK(status.exited() && status.exit_status() == i);
+            ++called;
+        }));
+    }
+    KTL_CHECK(monitor.watch(pids[0], [](const kps::child_exit &) {}) == false);
+
+    int reaped = 0;
+    while (reaped < count)
+    {
+        KTL_CHECK(kps::wait(kps::sigset(SIGCHLD), std::chrono::seconds(5)) ==
+                  SIGCHLD);
+        reaped += monitor.reap();
+    }
+
+    KTL_CHECK(called == count / 2);
+    KTL_CHECK(monitor.watched() == 0);
+    for (std::size_t i = 0; i < futures.size(); ++i)
+    {
+        const kps::child_exit status = futures[i].get();
+        KTL_CHECK(status.pid == pids[2 * i + 1]);
+        KTL_CHECK(status.exit_status() == static_cast< int >(2 * i + 1));
+    }
+
+    KTL_CHECK(monitor.unclaimed() == 1);
+    std::future< kps::child_exit > last = monitor.watch(pids.back());
+    KTL_CHECK(last.get().exit_status() == count - 1);
+    KTL_CHECK(monitor.unclaimed() == 0);
+
+    kps::this_thread::set_mask(oldsigset);
+}
+
+// A minimal io_uring, enough to drive uring_signal_reader without liburing.
+struct test_uring
+{
+    int fd;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    ::io_uring_sqe *sqes;
+    ::io_uring_cqe *cqes;
+
+    bool open(const unsigned entries)
+    {
+        ::io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd = static_cast< int >(::syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0 || !(params.features & IORING_FEAT_SINGLE_MMAP))
+            return false;
+
+        std::size_t size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        const std::size_t cq_size =
+            params.cq_off.cqes + params.cq_entries * sizeof(::io_uring_cqe);
+        if (cq_size > size)
+            size = cq_size;
+
+        char *rings = static_cast< char * >(
+            ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING));
+        sqes = static_cast< ::io_uring_sqe * >(
+            ::mmap(nullptr, params.sq_entries * sizeof(::io_uring_sqe),
+                   PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                   IORING_OFF_SQES));
+        if (rings == MAP_FAILED || sqes == MAP_FAILED)
+            return false;
+
+        sq_tail = reinterpret_cast< unsigned * >(rings + params.sq_off.tail);
+        sq_mask = reinterpret_cast< unsigned * >(rings + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast< unsigned * >(rings + params.sq_off.array);
+        cq_head = reinterpret_cast< unsigned * >(rings + params.cq_off.head);
+        cq_tail = reinterpret_cast< unsigned * >(rings + params.cq_off.tail);
+        cq_mask = reinterpret_cast< unsigned * >(rings + params.cq_off.ring_mask);
+        cqes = reinterpret_cast< ::io_uring_cqe * >(rings + params.cq_off.cqes);
+        return true;
+    }
+
+    ::io_uring_sqe *get_sqe()
+    {
+        const unsigned index = *sq_tail & *sq_mask;
+        sq_array[index] = index;
+        return &sqes[index];
+    }
+
+    bool submit()
+    {
+        __atomic_store_n(sq_tail, *sq_tail + 1, __ATOMIC_RELEASE);
+        return ::syscall(__NR_io_uring_enter, fd, 1, 0, 0, nullptr, 0) == 1;
+    }
+
+    const ::io_uring_cqe *wait_cqe()
+    {
+        for (;;)
+        {
+            const unsigned head = *cq_head;
+            if (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+                return &cqes[head & *cq_mask];
+            ::syscall(__NR_io_uring_enter, fd, 0, 1, IORING_ENTER_GETEVENTS,
+                      nullptr, 0);
+        }
+    }
+
+    void seen() { __atomic_store_n(cq_head, *cq_head + 1, __ATOMIC_RELEASE); }
+};
+
+void test_uring_reader()
+{
+    namespace kps = psig;
+
+    test_uring ring;
+    if (!ring.open(8))
+        return;  // io_uring is not available
+
+    const kps::sigset oldsigset = kps::this_thread::get_mask();
+    const kps::signum_t rtsig = kps::rt::reserve();
+    KTL_CHECK(rtsig > 0);
+
+    int handled = 0;
+    kps::signal_loop loop;
+    loop.set_handler(rtsig, [&](int) { return ++handled < 6; });
+
+    kps::uring_signal_reader reader(loop, 16);
+    KTL_CHECK(reader.is_open());
+
+    // five queued signals arrive in one completion
+    for (int i = 0; i < 5; ++i)
+    {
+        ::sigval value;
+        value.sival_int = i;
+        KTL_CHECK(::sigqueue(::getpid(), rtsig, value) == 0);
+    }
+    KTL_CHECK(reader.prepare(ring.get_sqe()));
+    KTL_CHECK(reader.prepare(ring.get_sqe()) == false);
+    KTL_CHECK(ring.submit());
+    KTL_CHECK(reader.complete(ring.wait_cqe()));
+    ring.seen();
+    KTL_CHECK(handled == 5);
+    KTL_CHECK(reader.finished() == false);
+
+    // a read submitted with nothing pending completes when a signal comes
+    KTL_CHECK(reader.prepare(ring.get_sqe()));
+    KTL_CHECK(ring.submit());
+    KTL_CHECK(reader.in_flight());
+    ::sigval value;
+    value.sival_int = 5;
+    KTL_CHECK(::sigqueue(::getpid(), rtsig, value) == 0);
+    KTL_CHECK(reader.complete(ring.wait_cqe()));
+    ring.seen();
+
+    KTL_CHECK(handled == 6);
+    KTL_CHECK(reader.finished());
+    KTL_CHECK(reader.error() == 0);
+    KTL_CHECK(loop.stats()[rtsig].delivered == 6);
+
+    ::close(ring.fd);
+    kps::rt::release(rtsig);
+    kps::this_thread::set_mask(oldsigset);
+}
+
+struct test_config
+{
+    explicit test_config(const int v) : value(v), twice(2 * v) {}
+    ~test_config()
+    {
+        value = -1;
+        twice = 1;
+    }
+
+    volatile int value;
+    volatile int twice;
+};
+
+void test_reloadable()
+{
+    namespace kps = psig;
+
+    const kps::sigset oldsigset = kps::this_thread::get_mask();
+
+    std::atomic< int > next(1);
+    kps::reloadable< test_config > config(
+        std::unique_ptr< test_config >(new test_config(0)), [&]() {
+            return std::unique_ptr< test_config >(new test_config(next++));
+        });
+    KTL_CHECK(config.read()->value == 0);
+    KTL_CHECK(config.version() == 1);
+
+    kps::signal_loop loop;
+    KTL_CHECK(config.attach(loop));
+    KTL_CHECK(loop.block_signals(kps::sigset(SIGHUP)));
+    loop.exec_async();
+
+    // readers must never see a torn or freed value
+    std::atomic< bool > running(true);
+    std::atomic< int > errors(0);
+    std::vector< std::thread > readers;
+    for (int i = 0; i < 4; ++i)
+    {
+        readers.emplace_back([&]() {
+            int last = 0;
+            while (running)
+            {
+                const kps::reloadable< test_config >::snapshot snapshot =
+                    config.read();
+                const int value = snapshot->value;
+                if (value < last || snapshot->twice != 2 * value)
+                    ++errors;
+                last = value;
+            }
+        });
+    }
+
+    for (int i = 0; i < 200; ++i)
+        KTL_CHECK(config.reload());
+    KTL_CHECK(config.version() == 201);
+
+    ::kill(::getpid(), SIGHUP);
+    const std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (config.version() == 201 && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::yield();
+
+    running = false;
+    for (std::thread &reader : readers)
+        reader.join();
+    loop.stop();
+
+    KTL_CHECK(errors == 0);
+    KTL_CHECK(config.version() == 202);
+    KTL_CHECK(config.read()->value == 201);
+
+    // publishing while this thread holds a snapshot must not wait for it
+    {
+        const kps::reloadable< test_config >::snapshot held = config.read();
+        config.publish(
+            std::unique_ptr< test_config >(new test_config(1000)));
+        KTL_CHECK(config.read()->value == 1000);
+        KTL_CHECK(config.retired() != 0);
+        KTL_CHECK(held->value == 201 && held->twice == 402);
+    }
+    KTL_CHECK(config.collect() == 0);
+    KTL_CHECK(config.retired() == 0);
+
+    kps::this_thread::set_mask(oldsigset);
+}
+
+void test_async_logger()
+{
+    namespace kps = psig;
+
+    const kps::sigset oldsigset = kps::this_thread::get_mask();
+
+    char path[] = "/tmp/psig_log_XXXXXX";
+    const int fd = ::mkstemp(path);
+    KTL_CHECK(fd >= 0);
+    ::close(fd);
+    const std::string rotated = std::string(path) + ".1";
+
+    std::ifstream::pos_type first_size = 0;
+    {
+        kps::async_logger logger(path, 1 << 12);
+        KTL_CHECK(logger.is_open());
+
+        // small rings force wraps; no record may be torn even when dropped
+        std::vector< std::thread > threads;
+        for (int t = 0; t < 4; ++t)
+        {
+            threads.emplace_back([&logger, t]() {
+                kps::async_logger::writer writer(logger);
+                KTL_CHECK(writer.is_open());
+                for (int i = 0; i < 1000; ++i)
+                {
+                    std::ostringstream line;
+                    line << "thread " << t << " line " << i << "\n";
+                    while (!writer.write(line.str()))
+                        std::this_thread::yield();
+                }
+            });
+        }
+        for (std::thread &thread : threads)
+            thread.join();
+
+        logger.flush();
+
+        std::ifstream in(path);
+        std::string line;
+        int counts[4] = {};
+        int next[4] = {};
+        bool ordered = true;
+        while (std::getline(in, line))
+        {
+            int t = 0;
+            int i = 0;
+            KTL_CHECK(std::sscanf(line.c_str(), "thread %d line %d", &t, &i) == 2);
+            if (t < 0 || t > 3)
+                continue;
+            ordered = ordered && (i == next[t]);
+            next[t] = i + 1;
+            ++counts[t];
+        }
+        KTL_CHECK(ordered);
+        for (int t = 0; t < 4; ++t)
+            KTL_CHECK(counts[t] == 1000);
+
+        // rotate by renaming, then reopen through a signal
+        kps::signal_loop loop;
+        KTL_CHECK(logger.attach(loop));
+        KTL_CHECK(loop.block_signals(kps::sigset{SIGHUP, SIGUSR1}));
+        loop.exec_async();
+
+        KTL_CHECK(::rename(path, rotated.c_str()) == 0);
+        ::kill(::getpid(), SIGHUP);
+
+        const std::chrono::steady_clock::time_point deadline =
+            std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (::access(path, F_OK) != 0 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::yield();
+
+        kps::async_logger::writer writer(logger);
+        KTL_CHECK(writer.write("after rotation\n"));
+        ::kill(::getpid(), SIGUSR1);
+        logger.flush();
+        loop.stop();
+
+        first_size = std::ifstream(rotated, std::ios::ate).tellg();
+    }
+
+    std::ifstream in(path);
+    std::string line;
+    KTL_CHECK(std::getline(in, line) && line == "after rotation");
+    KTL_CHECK(first_size > 0);
+    KTL_CHECK(std::ifstream(rotated, std::ios::ate).tellg() == first_size);
+
+    ::unlink(path);
+    ::unlink(rotated.c_str());
+    kps::this_thread::set_mask(oldsigset);
+}
+
+void test_stall_watchdog()
+{
+    namespace kps = psig;
+
+    const kps::sigset oldsigset = kps::this_thread::get_mask();
+
+    kps::timer_service timers(std::chrono::milliseconds(1));
+    KTL_CHECK(timers.is_open());
+
+    std::mutex mutex;
+    std::vector< kps::stall_report > reports;
+    kps::stall_watchdog watchdog(
+        timers, std::chrono::milliseconds(50),
+        [&](const kps::stall_report &report) {
+            std::lock_guard< std::mutex > lock(mutex);
+            reports.push_back(report);
+        });
+
+    kps::signal_loop loop;
+    KTL_CHECK(timers.attach(loop));
+    KTL_CHECK(loop.block_signals(kps::sigset(timers.signum())));
+    loop.exec_async();
+
+    // an idle thread is never reported, a busy one that stops beating is
+    std::atomic< ::pid_t > busy_tid(0);
+    std::atomic< bool > done(false);
+    std::thread idler([&]() {
+        const kps::stall_watchdog::thread_handle handle =
+            watchdog.register_thread("idler");
+        KTL_CHECK(handle != kps::stall_watchdog::invalid_handle);
+        watchdog.idle(handle);
+        while (!done)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        watchdog.unregister_thread(handle);
+    });
+    std::thread busy([&]() {
+        const kps::stall_watchdog::thread_handle handle =
+            watchdog.register_thread("busy");
+        KTL_CHECK(handle != kps::stall_watchdog::invalid_handle);
+        busy_tid = static_cast< ::pid_t >(::syscall(SYS_gettid));
+
+        const std::chrono::steady_clock::time_point until =
+            std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+        while (std::chrono::steady_clock::now() < until)
+            watchdog.beat(handle);
+
+        const std::chrono::steady_clock::time_point deadline =
+            std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (watchdog.stalls() == 0 && std::chrono::steady_clock::now() < deadline)
+        {
+        }
+
+        watchdog.beat(handle);
+        watchdog.unregister_thread(handle);
+    });
+
+    busy.join();
+    done = true;
+    idler.join();
+    loop.stop();
+
+    std::lock_guard< std::mutex > lock(mutex);
+    KTL_CHECK(reports.size() == 1);
+    KTL_CHECK(watchdog.stalls() == 1);
+    if (!reports.empty())
+    {
+        KTL_CHECK(reports[0].tid == busy_tid);
+        KTL_CHECK(reports[0].name == "busy");
+        KTL_CHECK(reports[0].stalled >= std::chrono::milliseconds(50));
+        KTL_CHECK(!reports[0].frames.empty());
+    }
+
+    // unregistering blocks the signal again; destruction restores the
+    // previous action and leaves a given signal reserved
+    const kps::signum_t signum = kps::rt::reserve();
+    struct ::sigaction before;
+    ::sigaction(signum, nullptr, &before);
+
+    std::unique_ptr< kps::stall_watchdog > other(new kps::stall_watchdog(
+        timers, std::chrono::milliseconds(50), kps::stall_watchdog::report_type(),
+        4, signum));
+    KTL_CHECK(other->signum() == signum);
+    std::atomic< bool > unblocked(false);
+    std::atomic< bool > reblocked(false);
+    std::thread worker([&]() {
+        kps::this_thread::add_mask(signum);
+        const kps::stall_watchdog::thread_handle handle = other->register_thread();
+        KTL_CHECK(handle != kps::stall_watchdog::invalid_handle);
+        unblocked = !kps::this_thread::get_mask().has(signum);
+        other->unregister_thread(handle);
+        reblocked = kps::this_thread::get_mask().has(signum);
+    });
+    worker.join();
+    KTL_CHECK(unblocked);
+    KTL_CHECK(reblocked);
+
+    other.reset();
+    struct ::sigaction after;
+    ::sigaction(signum, nullptr, &after);
+    KTL_CHECK(after.sa_handler == before.sa_handler);
+    KTL_CHECK(kps::rt::reserved(signum));
+    kps::rt::release(signum);
+
+    kps::this_thread::set_mask(oldsigset);
+}
+
+void test_shutdown()
+{
+    namespace kps = psig;
+    typedef std::chrono::steady_clock clock_type;
+
+    const kps::sigset signals(SIGTERM);
+    const kps::sigset oldsigset = kps::this_thread::add_mask(signals);
+
+    // a stage stops in parallel and only after the previous one
+    {
+        std::atomic< int > stopped(0);
+        std::atomic< int > seen_by_last(-1);
+        kps::shutdown_orchestrator shutdown;
+        for (int i = 0; i < 3; ++i)
+        {
+            shutdown.add(0, "listener", [&]() {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                ++stopped;
+            });
+        }
+        shutdown.add(1, "flusher", [&]() { seen_by_last = stopped.load(); });
+        KTL_CHECK(shutdown.size() == 4);
+
+        kps::signal_loop loop;
+        KTL_CHECK(shutdown.attach(loop, signals));
+        KTL_CHECK(loop.block_signals(signals));
+        loop.exec_async(shutdown.exit_handler());
+
+        const clock_type::time_point start = clock_type::now();
+        ::kill(::getpid(), SIGTERM);
+        loop.wait_for_exec_async();
+
+        KTL_CHECK(loop.exit_code() == 0);
+        KTL_CHECK(!shutdown.forced());
+        KTL_CHECK(seen_by_last == 3);
+        KTL_CHECK(clock_type::now() - start < std::chrono::milliseconds(250));
+    }
+
+    // a missed deadline forces the exit and skips later stages
+    {
+        std::atomic< bool > release(false);
+        std::atomic< bool > returned(false);
+        bool later = false;
+        kps::shutdown_orchestrator shutdown(1, []() { return 42; });
+        shutdown.add(0, "fast", []() {});
+        shutdown.add(0,
+                     "stuck",
+                     [&]() {
+                         while (!release)
+                             std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                         returned = true;
+                     },
+                     std::chrono::milliseconds(50));
+        shutdown.add(1, "later", [&]() { later = true; });
+
+        kps::signal_loop loop;
+        KTL_CHECK(shutdown.attach(loop, signals));
+
+        const clock_type::time_point start = clock_type::now();
+        KTL_CHECK(shutdown.run() == 42);
+        KTL_CHECK(clock_type::now() - start >= std::chrono::milliseconds(50));
+        KTL_CHECK(shutdown.forced());
+        KTL_CHECK(shutdown.pending() == std::vector< std::string >(1, "stuck"));
+        KTL_CHECK(!later);
+
+        release = true;
+        while (!returned)
+            std::this_thread::yield();
+    }
+
+    // a second signal escalates without waiting for the deadline
+    {
+        std::atomic< bool > release(false);
+        std::atomic< bool > returned(false);
+        std::atomic< bool > stopping(false);
+        kps::shutdown_orchestrator shutdown(1, []() { return 43; });
+        shutdown.add(0,
+                     "stuck",
+                     [&]() {
+                         stopping = true;
+                         while (!release)
+                             std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                         returned = true;
+                     },
+                     std::chrono::seconds(10));
+
+        kps::signal_loop loop;
+        KTL_CHECK(shutdown.attach(loop, signals));
+        KTL_CHECK(loop.block_signals(signals));
+        loop.exec_async(shutdown.exit_handler());
+
+        const clock_type::time_point start = clock_type::now();
+        ::kill(::getpid(), SIGTERM);
+        while (!stopping)
+            std::this_thread::yield();
+        ::kill(::getpid(), SIGTERM);
+        loop.wait_for_exec_async();
+
+        KTL_CHECK(loop.exit_code() == 43);
+        KTL_CHECK(shutdown.forced());
+        KTL_CHECK(clock_type::now() - start < std::chrono::seconds(5));
+
+        release = true;
+        while (!returned)
+            std::this_thread::yield();
+    }
+
+    kps::this_thread::set_mask(oldsigset);
+}
+
 void test_wait()
 {
     namespace kps = psig;
@@ -88,7 +1660,32 @@ void test_timed_wait()
 
 extern "C" int main(int argc, char *argv[])
 {
+    test_sigset();
     test_mask();
+    test_scoped_mask();
+    test_signal_fd();
+    test_wait_batch();
+    test_dispatch();
+    test_channel();
+    test_stats();
+    test_coroutine();
+    test_supervisor();
+    test_timer();
+    test_interrupt();
+    test_router();
+    test_thread_options();
+    test_replace_handlers();
+    test_change_handlers();
+    test_fault();
+    test_profiler();
+    test_profiler_attach();
+    test_stop();
+    test_child_monitor();
+    test_uring_reader();
+    test_reloadable();
+    test_async_logger();
+    test_stall_watchdog();
+    test_shutdown();
     test_wait();
     test_rt_wait();
     test_timed_wait();